@@ -1,4 +1,5 @@
 CONFIG += qt
+QT += network
 CONFIG += uitools debug_and_release
 UI_HEADERS_DIR = ./ui_inc
 MOC_DIR = ./moc
@@ -31,14 +32,55 @@ FORMS = ui/ConfigureDlg.ui \
 RESOURCES = ui/res/HTCNC.qrc
 
 SOURCES += \
+			src/HTCNCBlockPyramid.cpp \
 			src/HTCNCConsole.cpp \
+			src/HTCNCDepthMap.cpp \
+			src/HTCNCDotField.cpp \
+			src/HTCNCDotModulator.cpp \
+			src/HTCNCGCodeSimulator.cpp \
+			src/HTCNCGreyPlane.cpp \
 			src/HTCNCHalftoner.cpp \
+			src/HTCNCImageLoader.cpp \
+			src/HTCNCImageView.cpp \
+			src/HTCNCIntegralImage.cpp \
+			src/HTCNCJobCache.cpp \
+			src/HTCNCJobPlanner.cpp \
+			src/HTCNCJobQueue.cpp \
+			src/HTCNCJobServer.cpp \
+			src/HTCNCKernels.cpp \
+			src/HTCNCLattice.cpp \
 			src/HTCNCMain.cpp \
-			src/HTCNCMainWindow.cpp 
+			src/HTCNCMainWindow.cpp \
+			src/HTCNCProfile.cpp \
+			src/HTCNCProgress.cpp \
+			src/HTCNCSourceCache.cpp 
 
 HEADERS += \
+			src/HTCNCBlockPyramid.h \
 			src/HTCNCConsole.h \
+			src/HTCNCDepthMap.h \
+			src/HTCNCDotField.h \
+			src/HTCNCDotModulator.h \
+			src/HTCNCGCodeSimulator.h \
+			src/HTCNCGreyPlane.h \
 			src/HTCNCHalftoner.h \
-			src/HTCNCMainWindow.h 
+			src/HTCNCImageLoader.h \
+			src/HTCNCImageView.h \
+			src/HTCNCIntegralImage.h \
+			src/HTCNCJobCache.h \
+			src/HTCNCJobPlanner.h \
+			src/HTCNCJobQueue.h \
+			src/HTCNCJobServer.h \
+			src/HTCNCKernels.h \
+			src/HTCNCLattice.h \
+			src/HTCNCMainWindow.h \
+			src/HTCNCProfile.h \
+			src/HTCNCProgress.h \
+			src/HTCNCSourceCache.h 
 
 			
+# "make check" builds and runs the regression tests in tests/.
+check.commands = cd tests && $(QMAKE) HalftonerTest.pro && $(MAKE) && .$${SLASH}HalftonerTest
+# "make bench" builds and runs the kernel benchmarks in tests/.
+bench.commands = cd tests && $(QMAKE) -o Makefile.bench Benchmark.pro && $(MAKE) -f Makefile.bench && .$${SLASH}HalftonerBenchmark
+QMAKE_EXTRA_TARGETS += check bench
@@ -0,0 +1,118 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "HTCNCBlockPyramid.h"
+#include "HTCNCGreyPlane.h"
+
+#include <algorithm>
+
+namespace HTCNC
+{
+	BlockPyramid::BlockPyramid( const GreyPlane& src, int blockSize )
+	{
+		Level	base;
+
+		base.m_blockSize = blockSize;
+		base.m_columns = ( src.getWidth() + blockSize - 1 ) / blockSize;
+		base.m_rows = ( src.getHeight() + blockSize - 1 ) / blockSize;
+		base.m_min.assign( base.m_columns * base.m_rows, 255 );
+		base.m_max.assign( base.m_columns * base.m_rows, 0 );
+
+		for ( int y = 0; y < src.getHeight(); ++y )
+		{
+			const unsigned char*	line( src.getRow( y ) );
+			int	row_offset( ( y / blockSize ) * base.m_columns );
+
+			for ( int bx = 0; bx < base.m_columns; ++bx )
+			{
+				unsigned char&	lo( base.m_min[row_offset + bx] );
+				unsigned char&	hi( base.m_max[row_offset + bx] );
+				int	end( std::min( src.getWidth(), ( bx + 1 ) * blockSize ) );
+
+				for ( int x = bx * blockSize; x < end; ++x )
+				{
+					unsigned char	gray( line[x] );
+
+					if ( gray < lo )
+						lo = gray;
+					if ( gray > hi )
+						hi = gray;
+				}
+			}
+		}
+		m_levels.push_back( base );
+
+		// Each level up combines 2x2 blocks of the one below it.
+		while ( m_levels.back().m_columns > 1 || m_levels.back().m_rows > 1 )
+		{
+			const Level&	below( m_levels.back() );
+			Level	level;
+
+			level.m_blockSize = below.m_blockSize * 2;
+			level.m_columns = ( below.m_columns + 1 ) / 2;
+			level.m_rows = ( below.m_rows + 1 ) / 2;
+			level.m_min.assign( level.m_columns * level.m_rows, 255 );
+			level.m_max.assign( level.m_columns * level.m_rows, 0 );
+
+			for ( int r = 0; r < below.m_rows; ++r )
+			{
+				for ( int c = 0; c < below.m_columns; ++c )
+				{
+					int	from( r * below.m_columns + c );
+					int	to( ( r / 2 ) * level.m_columns + c / 2 );
+
+					level.m_min[to] = std::min( level.m_min[to], below.m_min[from] );
+					level.m_max[to] = std::max( level.m_max[to], below.m_max[from] );
+				}
+			}
+			m_levels.push_back( level );
+		}
+	}
+
+
+	bool BlockPyramid::isUniform( int left, int top, int right, int bottom, int& value ) const
+	{
+		if ( m_levels.empty() || right <= left || bottom <= top )
+			return false;
+
+		// Use the finest level whose blocks are at least as big as the
+		// rectangle, so that at most 2x2 blocks need to be looked at.
+		int	size( std::max( right - left, bottom - top ) );
+		size_t	l( 0 );
+
+		while ( l + 1 < m_levels.size() && m_levels[l].m_blockSize < size )
+			++l;
+
+		const Level&	level( m_levels[l] );
+		int	lo( 255 ), hi( 0 );
+
+		for ( int r = top / level.m_blockSize; r <= ( bottom - 1 ) / level.m_blockSize; ++r )
+		{
+			for ( int c = left / level.m_blockSize; c <= ( right - 1 ) / level.m_blockSize; ++c )
+			{
+				lo = std::min( lo, int( level.m_min[r * level.m_columns + c] ) );
+				hi = std::max( hi, int( level.m_max[r * level.m_columns + c] ) );
+				if ( lo != hi )
+					return false;
+			}
+		}
+		value = lo;
+		return true;
+	}
+}
+
@@ -0,0 +1,74 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#ifndef HTCNCBLOCKPYRAMID_H
+#define HTCNCBLOCKPYRAMID_H
+
+#include <vector>
+
+namespace HTCNC
+{
+	class GreyPlane;
+
+	/*@brief Minimum and maximum greyscale intensities of an image, by block.
+	 *
+	 * The bottom level holds the min/max of each square block of pixels; each
+	 * level above it combines 2x2 blocks of the level below.  This makes it
+	 * cheap to find out whether a rectangle of the image is all one intensity
+	 * (which is common in line art and logos) without looking at its pixels.
+	 **/
+	class BlockPyramid
+	{
+		public:
+			/**
+			 * @brief Builds the pyramid.
+			 * @param src The image to summarize.
+			 * @param blockSize The size of the blocks at the bottom level.
+			 **/
+			BlockPyramid( const GreyPlane& src, int blockSize = 8 );
+
+			/**
+			 * @brief Checks whether a rectangle of the image is a single intensity.
+			 * The check is conservative: it looks at whole blocks, so it can
+			 * return false for a rectangle that happens to be uniform, but it
+			 * never returns true for one that is not.
+			 * @param left, top, right, bottom The rectangle (right and bottom are
+			 * exclusive), which must lie within the image.
+			 * @param value Receives the intensity if the rectangle is uniform.
+			 **/
+			bool isUniform( int left, int top, int right, int bottom, int& value ) const;
+
+		private:
+			struct Level
+			{
+				int	m_blockSize;
+				int	m_columns;
+				int	m_rows;
+				std::vector<unsigned char>	m_min;
+				std::vector<unsigned char>	m_max;
+			};
+
+			std::vector<Level>	m_levels;
+	};
+
+}	// namespace HTCNC
+
+
+#endif
+
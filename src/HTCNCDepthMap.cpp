@@ -0,0 +1,106 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "HTCNCDepthMap.h"
+
+#include <algorithm>
+
+#include <math.h>
+
+namespace HTCNC
+{
+	DepthMap::DepthMap( int levels, double gamma )
+		: m_levelForIntensity( INTENSITY_COUNT )
+		, m_tones( INTENSITY_COUNT )
+	{
+		if ( gamma <= 0 )
+			gamma = 1.0;
+
+		for ( int i = 0; i < INTENSITY_COUNT; ++i )
+		{
+			double	tone( i / 255.0 );
+
+			m_tones[i] = ( gamma == 1.0 ? tone : pow( tone, gamma ) );
+		}
+
+		if ( levels <= 0 )
+		{
+			// No quantization: each intensity is its own level.
+			m_dotSizes.resize( INTENSITY_COUNT );
+			for ( int i = 0; i < INTENSITY_COUNT; ++i )
+			{
+				m_levelForIntensity[i] = i;
+				m_dotSizes[i] = m_tones[i];
+			}
+			return;
+		}
+
+		m_dotSizes.resize( levels + 1 );
+		for ( int l = 0; l <= levels; ++l )
+		{
+			m_dotSizes[l] = double( l ) / levels;
+		}
+
+		for ( int i = 0; i < INTENSITY_COUNT; ++i )
+		{
+			m_levelForIntensity[i] = int( floor( m_tones[i] * levels + 0.5 ) );
+		}
+	}
+
+
+	int DepthMap::getLowerLevel( double tone ) const
+	{
+		// The dot sizes are sorted, so find the first one that is larger than
+		// tone and step back one.
+		std::vector<double>::const_iterator	it( std::upper_bound( m_dotSizes.begin(), m_dotSizes.end(), tone ) );
+
+		if ( it == m_dotSizes.begin() )
+			return 0;
+		return static_cast<int>( it - m_dotSizes.begin() ) - 1;
+	}
+
+
+	int DepthMap::getNearestLevel( double tone ) const
+	{
+		int	level( getLowerLevel( tone ) );
+
+		if ( level + 1 < getLevelCount() &&
+				 m_dotSizes[level + 1] - tone < tone - m_dotSizes[level] )
+		{
+			++level;
+		}
+		return level;
+	}
+
+
+	int DepthMap::getDitheredLevel( double tone, double threshold ) const
+	{
+		int	level( getLowerLevel( tone ) );
+
+		if ( level + 1 < getLevelCount() )
+		{
+			double	lower( m_dotSizes[level] );
+			double	upper( m_dotSizes[level + 1] );
+
+			if ( ( tone - lower ) / ( upper - lower ) > threshold )
+				++level;
+		}
+		return level;
+	}
+}
+
@@ -0,0 +1,99 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#ifndef HTCNCDEPTHMAP_H
+#define HTCNCDEPTHMAP_H
+
+#include <vector>
+
+namespace HTCNC
+{
+
+	/*@brief Maps mean greyscale intensities to quantized dot sizes.
+	 *
+	 * Every possible intensity (0..255) is run through a gamma tone curve and
+	 * then snapped to one of a fixed number of levels when the table is built,
+	 * so looking up a dot size is just two table reads.  Because each dot only
+	 * carries a level index, anything that depends on the dot size (such as the
+	 * text of a plunge move) can be computed once per level.
+	 **/
+	class DepthMap
+	{
+		public:
+			enum
+			{
+				INTENSITY_COUNT = 256	/// Number of distinct mean intensities
+			};
+
+			/**
+			 * @brief Builds the lookup tables.
+			 * @param levels The number of non-zero dot sizes.  0 means the dot
+			 * size is not quantized (every intensity gets its own level).
+			 * @param gamma Exponent applied to the normalized intensity before
+			 * quantization.  1.0 leaves the tone curve linear.
+			 **/
+			DepthMap( int levels, double gamma );
+
+			/// Returns the level for a mean intensity in the range [0..255].
+			int getLevel( int intensity ) const
+			{
+				return m_levelForIntensity[intensity];
+			}
+
+			/// Returns the dot size, in the range [0..1], for a level.
+			double getDotSize( int level ) const
+			{
+				return m_dotSizes[level];
+			}
+
+			/// Returns the unquantized dot size (the intensity after the tone
+			/// curve is applied), in the range [0..1].
+			double getTone( int intensity ) const
+			{
+				return m_tones[intensity];
+			}
+
+			/// Returns the level whose dot size is closest to the given tone.
+			int getNearestLevel( double tone ) const;
+
+			/// Returns one of the two levels that bracket the given tone.  The
+			/// upper level is chosen if the tone's fractional position between
+			/// the two is greater than threshold, which should be in [0..1).
+			int getDitheredLevel( double tone, double threshold ) const;
+
+			/// Returns the number of levels, including the zero-sized level.
+			int getLevelCount() const
+			{
+				return static_cast<int>( m_dotSizes.size() );
+			}
+
+		private:
+			/// Returns the highest level whose dot size is <= tone.
+			int getLowerLevel( double tone ) const;
+
+			std::vector<int>		m_levelForIntensity;
+			std::vector<double>	m_tones;
+			std::vector<double>	m_dotSizes;
+	};
+
+}	// namespace HTCNC
+
+
+#endif
+
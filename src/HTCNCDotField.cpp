@@ -0,0 +1,54 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "HTCNCDotField.h"
+
+namespace HTCNC
+{
+	DotField::DotField( const std::vector<int>& levels, int rows, int columns )
+		: m_rowStarts( rows + 1, 0 )
+		, m_dotCount( 0 )
+	{
+		for ( int r = 0; r < rows; ++r )
+		{
+			int	row( r * columns );
+
+			m_rowStarts[r] = static_cast<int>( m_runs.size() );
+			for ( int c = 0; c < columns; )
+			{
+				if ( levels[row + c] == 0 )
+				{
+					++c;
+					continue;
+				}
+
+				Run	run;
+
+				run.m_column = c;
+				run.m_level = levels[row + c];
+				while ( c < columns && levels[row + c] == run.m_level )
+					++c;
+				run.m_length = c - run.m_column;
+				m_dotCount += run.m_length;
+				m_runs.push_back( run );
+			}
+		}
+		m_rowStarts[rows] = static_cast<int>( m_runs.size() );
+	}
+}
+
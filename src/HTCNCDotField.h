@@ -0,0 +1,88 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#ifndef HTCNCDOTFIELD_H
+#define HTCNCDOTFIELD_H
+
+#include <vector>
+
+namespace HTCNC
+{
+
+	/*@brief Sparse, run-length encoded storage for the levels of a cell grid.
+	 *
+	 * Each row is stored as a list of runs of consecutive cells that share a
+	 * non-zero level.  Cells with a level of zero (no dot) are not stored at
+	 * all, so anything that walks the runs skips empty stretches of the image
+	 * for free.
+	 **/
+	class DotField
+	{
+		public:
+			struct Run
+			{
+				int	m_column;	/// First column of the run
+				int	m_length;	/// Number of cells in the run
+				int	m_level;	/// DepthMap level shared by every cell in the run
+			};
+
+			/**
+			 * @brief Encodes a grid of levels.
+			 * @param levels The level of each cell, row major.
+			 * @param rows The number of rows in the grid.
+			 * @param columns The number of columns in the grid.
+			 **/
+			DotField( const std::vector<int>& levels, int rows, int columns );
+
+			/// Returns the number of rows in the grid.
+			int getRows() const
+			{
+				return static_cast<int>( m_rowStarts.size() ) - 1;
+			}
+
+			/// Returns the index of the first run of a row.  The runs of row r
+			/// are [getRowStart(r)..getRowStart(r+1)).
+			int getRowStart( int row ) const
+			{
+				return m_rowStarts[row];
+			}
+
+			/// Returns a run.
+			const Run& getRun( int index ) const
+			{
+				return m_runs[index];
+			}
+
+			/// Returns the number of cells with a dot.
+			int getDotCount() const
+			{
+				return m_dotCount;
+			}
+
+		private:
+			std::vector<Run>	m_runs;
+			std::vector<int>	m_rowStarts;
+			int	m_dotCount;
+	};
+
+}	// namespace HTCNC
+
+
+#endif
+
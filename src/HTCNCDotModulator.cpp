@@ -0,0 +1,374 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "HTCNCDotModulator.h"
+#include "HTCNCDepthMap.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+#include <algorithm>
+
+#include <math.h>
+
+namespace HTCNC
+{
+	namespace
+	{
+		// One entry of an error diffusion kernel: the error is pushed to the
+		// cell dr rows down and dc columns over with a weight of w/divisor.
+		struct Weight
+		{
+			int	dr;
+			int	dc;
+			int	w;
+		};
+
+		const Weight	FLOYD_STEINBERG_WEIGHTS[] =
+		{
+			               { 0, 1, 7 },
+			{ 1, -1, 3 }, { 1, 0, 5 }, { 1, 1, 1 }
+		};
+
+		const Weight	JARVIS_WEIGHTS[] =
+		{
+			                                           { 0, 1, 7 }, { 0, 2, 5 },
+			{ 1, -2, 3 }, { 1, -1, 5 }, { 1, 0, 7 }, { 1, 1, 5 }, { 1, 2, 3 },
+			{ 2, -2, 1 }, { 2, -1, 3 }, { 2, 0, 5 }, { 2, 1, 3 }, { 2, 2, 1 }
+		};
+
+		const int	BAYER_MATRIX[8][8] =
+		{
+			{  0, 32,  8, 40,  2, 34, 10, 42 },
+			{ 48, 16, 56, 24, 50, 18, 58, 26 },
+			{ 12, 44,  4, 36, 14, 46,  6, 38 },
+			{ 60, 28, 52, 20, 62, 30, 54, 22 },
+			{  3, 35, 11, 43,  1, 33,  9, 41 },
+			{ 51, 19, 59, 27, 49, 17, 57, 25 },
+			{ 15, 47,  7, 39, 13, 45,  5, 37 },
+			{ 63, 31, 55, 23, 61, 29, 53, 21 }
+		};
+
+		// Interleaved gradient noise: a cheap threshold pattern with most of
+		// its energy at high frequencies, which makes a decent stand-in for a
+		// blue noise mask without having to ship one.
+		double noiseThreshold( int x, int y )
+		{
+			double	f( 0.06711056 * x + 0.00583715 * y );
+
+			f = 52.9829189 * ( f - floor( f ) );
+			return f - floor( f );
+		}
+
+
+		// How many cells a diffusion worker finishes between telling the
+		// worker on the next row how far it has got.
+		const int	PUBLISH_INTERVAL( 16 );
+
+
+		// State shared by the workers of an error diffusion run.
+		struct DiffusionJob
+		{
+			const DepthMap*					m_depthMap;
+			const std::vector<int>*	m_intensities;
+			std::vector<int>*				m_levels;
+			int				m_rows;
+			int				m_columns;
+			const Weight*	m_weights;
+			int				m_weightCount;
+			int				m_divisor;
+			/// How far (in columns) the kernel reaches to either side.
+			int				m_reach;
+			/// Error delivered to each cell by the row above it.
+			std::vector<double>	m_errorFromAbove;
+			/// Error delivered to each cell by the row two above it.  Keeping
+			/// this separate means each buffer only ever has one writer.
+			std::vector<double>	m_errorFromTwoAbove;
+
+			/// Guards the members below.
+			QMutex	m_mutex;
+			/// Signalled when a row gets further along or a helper finishes.
+			QWaitCondition	m_changed;
+			/// The number of cells finished in each row (as far as the other
+			/// workers have been told).
+			std::vector<int>	m_finished;
+			/// The next row that no worker has taken yet.
+			int	m_nextRow;
+			/// The number of helper threads that haven't finished.
+			int	m_helpers;
+			/// Set if the run was cancelled; nobody waits or takes rows after.
+			bool	m_cancelled;
+		};
+
+
+		void diffuseRow( DiffusionJob& job, int r )
+		{
+			int			columns( job.m_columns );
+			double	carry1(0), carry2(0);
+			int			seen( r == 0 ? columns : 0 );
+
+			for ( int c = 0; c < columns; ++c )
+			{
+				// Wait until the row above has delivered all of its error to
+				// this cell.
+				int	needed( std::min( c + job.m_reach + 1, columns ) );
+
+				if ( seen < needed )
+				{
+					QMutexLocker	lock( &job.m_mutex );
+
+					while ( job.m_finished[r - 1] < needed && ! job.m_cancelled )
+						job.m_changed.wait( &job.m_mutex );
+					if ( job.m_cancelled )
+						return;
+					seen = job.m_finished[r - 1];
+				}
+
+				int	idx( r * columns + c );
+
+				if ( (*job.m_intensities)[idx] >= 0 )
+				{
+					double	tone( job.m_depthMap->getTone( (*job.m_intensities)[idx] ) +
+												job.m_errorFromAbove[idx] + job.m_errorFromTwoAbove[idx] + carry1 );
+					int			level( job.m_depthMap->getNearestLevel( tone ) );
+					double	error( ( tone - job.m_depthMap->getDotSize( level ) ) / job.m_divisor );
+
+					(*job.m_levels)[idx] = level;
+					carry1 = carry2;
+					carry2 = 0;
+
+					for ( int w = 0; w < job.m_weightCount; ++w )
+					{
+						const Weight&	wt( job.m_weights[w] );
+						int	rr( r + wt.dr );
+						int	cc( c + wt.dc );
+
+						if ( wt.dr == 0 )
+						{
+							if ( wt.dc == 1 )
+								carry1 += error * wt.w;
+							else
+								carry2 += error * wt.w;
+						}
+						else if ( rr < job.m_rows && cc >= 0 && cc < columns )
+						{
+							if ( wt.dr == 1 )
+								job.m_errorFromAbove[rr * columns + cc] += error * wt.w;
+							else
+								job.m_errorFromTwoAbove[rr * columns + cc] += error * wt.w;
+						}
+					}
+				}
+
+				if ( ( c + 1 ) % PUBLISH_INTERVAL == 0 || c + 1 == columns )
+				{
+					QMutexLocker	lock( &job.m_mutex );
+
+					job.m_finished[r] = c + 1;
+					job.m_changed.wakeAll();
+				}
+			}
+		}
+
+
+		// Takes the next row that no worker has taken yet, or returns false if
+		// there are none left.  Rows are taken in order, so the row a worker
+		// waits on has always been taken by a worker that is running, however
+		// few of them get a thread.
+		bool takeRow( DiffusionJob& job, int& r )
+		{
+			QMutexLocker	lock( &job.m_mutex );
+
+			if ( job.m_nextRow >= job.m_rows || job.m_cancelled )
+				return false;
+			r = job.m_nextRow++;
+			return true;
+		}
+
+
+		// Helps the calling thread with an error diffusion run.
+		class DiffusionHelper : public QRunnable
+		{
+			public:
+				DiffusionHelper( DiffusionJob& job )
+					: m_job( job )
+				{
+				}
+
+				virtual void run()
+				{
+					int	r;
+
+					while ( takeRow( m_job, r ) )
+						diffuseRow( m_job, r );
+
+					QMutexLocker	lock( &m_job.m_mutex );
+
+					--m_job.m_helpers;
+					m_job.m_changed.wakeAll();
+				}
+
+			private:
+				DiffusionJob&	m_job;
+		};
+	}
+
+
+	DotModulator::DotModulator( Halftoner::Modulation mode, const DepthMap& depthMap, int maxThreads )
+		: m_mode( mode )
+		, m_depthMap( depthMap )
+		, m_maxThreads( maxThreads > 0 ? maxThreads : QThread::idealThreadCount() )
+	{
+	}
+
+
+	bool DotModulator::modulate( const std::vector<int>& intensities,
+															 int columns,
+															 std::vector<int>& levels,
+															 const ProgressStage& progress ) const
+	{
+		int	rows( columns > 0 ? static_cast<int>( intensities.size() ) / columns : 0 );
+
+		levels.assign( intensities.size(), 0 );
+
+		if ( m_mode == Halftoner::FLOYD_STEINBERG || m_mode == Halftoner::JARVIS )
+			return modulateDiffusion( intensities, rows, columns, levels, progress );
+
+		for ( int r = 0; r < rows; ++r )
+		{
+			if ( ! progress.update( r, rows ) )
+				return false;
+
+			for ( int c = 0; c < columns; ++c )
+			{
+				int	idx( r * columns + c );
+				int	intensity( intensities[idx] );
+
+				if ( intensity < 0 )
+					continue;
+
+				if ( m_mode == Halftoner::ORDERED )
+				{
+					double	threshold( ( BAYER_MATRIX[r & 7][c & 7] + 0.5 ) / 64.0 );
+
+					levels[idx] = m_depthMap.getDitheredLevel( m_depthMap.getTone( intensity ), threshold );
+				}
+				else if ( m_mode == Halftoner::NOISE )
+				{
+					levels[idx] = m_depthMap.getDitheredLevel( m_depthMap.getTone( intensity ), noiseThreshold( c, r ) );
+				}
+				else
+				{
+					levels[idx] = m_depthMap.getLevel( intensity );
+				}
+			}
+		}
+		return true;
+	}
+
+
+	bool DotModulator::modulateDiffusion( const std::vector<int>& intensities,
+																				int rows,
+																				int columns,
+																				std::vector<int>& levels,
+																				const ProgressStage& progress ) const
+	{
+		DiffusionJob	job;
+
+		if ( rows == 0 || columns == 0 )
+			return true;
+
+		job.m_depthMap = &m_depthMap;
+		job.m_intensities = &intensities;
+		job.m_levels = &levels;
+		job.m_rows = rows;
+		job.m_columns = columns;
+		if ( m_mode == Halftoner::JARVIS )
+		{
+			job.m_weights = JARVIS_WEIGHTS;
+			job.m_weightCount = sizeof( JARVIS_WEIGHTS ) / sizeof( Weight );
+			job.m_divisor = 48;
+			job.m_reach = 2;
+		}
+		else
+		{
+			job.m_weights = FLOYD_STEINBERG_WEIGHTS;
+			job.m_weightCount = sizeof( FLOYD_STEINBERG_WEIGHTS ) / sizeof( Weight );
+			job.m_divisor = 16;
+			job.m_reach = 1;
+		}
+		job.m_errorFromAbove.assign( intensities.size(), 0.0 );
+		job.m_errorFromTwoAbove.assign( intensities.size(), 0.0 );
+		job.m_finished.assign( rows, 0 );
+		job.m_nextRow = 0;
+		job.m_helpers = 0;
+		job.m_cancelled = false;
+
+		// Helpers are only started if the shared pool has a thread free right
+		// now; the calling thread works through the rows as well, so the run
+		// finishes however many of them there are.
+		int	helpers( std::min( m_maxThreads, rows ) - 1 );
+
+		for ( int h = 0; h < helpers; ++h )
+		{
+			DiffusionHelper*	helper( new DiffusionHelper( job ) );
+
+			{
+				QMutexLocker	lock( &job.m_mutex );
+
+				++job.m_helpers;
+			}
+			if ( ! QThreadPool::globalInstance()->tryStart( helper ) )
+			{
+				QMutexLocker	lock( &job.m_mutex );
+
+				--job.m_helpers;
+				delete helper;
+				break;
+			}
+		}
+
+		// Only this thread reports progress (which may touch the GUI).  Any
+		// row finished means all the rows before it are nearly done.
+		int	r;
+
+		while ( takeRow( job, r ) )
+		{
+			diffuseRow( job, r );
+			if ( ! progress.update( r + 1, rows ) )
+			{
+				QMutexLocker	lock( &job.m_mutex );
+
+				job.m_cancelled = true;
+				job.m_changed.wakeAll();
+			}
+		}
+
+		// The job lives on this stack, so wait for the helpers to let go of it.
+		QMutexLocker	lock( &job.m_mutex );
+
+		while ( job.m_helpers > 0 )
+			job.m_changed.wait( &job.m_mutex );
+		return ! job.m_cancelled;
+	}
+}
+
@@ -0,0 +1,89 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#ifndef HTCNCDOTMODULATOR_H
+#define HTCNCDOTMODULATOR_H
+
+#include "HTCNCHalftoner.h"
+#include "HTCNCProgress.h"
+
+#include <vector>
+
+namespace HTCNC
+{
+	class DepthMap;
+
+	/*@brief Turns the mean intensity of each halftone cell into a DepthMap level.
+	 *
+	 * The cells are laid out as a grid of rows x columns (row major).  Grid
+	 * positions that have no cell (the lattice need not be rectangular) are
+	 * marked with an intensity of -1 and are skipped.
+	 *
+	 * BOX_MEAN looks each cell up independently.  The error diffusion modes
+	 * push the quantization error of each cell onto its unprocessed neighbors,
+	 * which preserves tonal detail when only a few depth levels are used.
+	 * They are run as a wavefront: the calling thread and any helpers it can
+	 * get from the global thread pool each take the next row in turn, and
+	 * only wait (on a condition, not spinning) for the row above to get far
+	 * enough ahead that every error they need has been delivered.  The
+	 * threshold modes compare each cell's
+	 * position between two levels against a fixed pattern.
+	 **/
+	class DotModulator
+	{
+		public:
+			/**
+			 * @brief Constructs a modulator.
+			 * @param mode The modulation strategy to use.
+			 * @param depthMap The levels that cells are quantized to.
+			 * @param maxThreads The most threads (including the caller's) to
+			 * use; 0 uses one per core.
+			 **/
+			DotModulator( Halftoner::Modulation mode, const DepthMap& depthMap, int maxThreads = 0 );
+
+			/**
+			 * @brief Computes the level of every cell.
+			 * @param intensities The mean intensity [0..255] of each cell, or -1.
+			 * @param columns The number of cells in each row.
+			 * @param levels Receives the level of each cell.
+			 * @param progress Told about each row; checked for cancellation.
+			 * @return false if cancelled (levels is then incomplete).
+			 **/
+			bool modulate( const std::vector<int>& intensities,
+										 int columns,
+										 std::vector<int>& levels,
+										 const ProgressStage& progress = ProgressStage() ) const;
+
+		private:
+			bool modulateDiffusion( const std::vector<int>& intensities,
+															int rows,
+															int columns,
+															std::vector<int>& levels,
+															const ProgressStage& progress ) const;
+
+			Halftoner::Modulation	m_mode;
+			const DepthMap&				m_depthMap;
+			int										m_maxThreads;
+	};
+
+}	// namespace HTCNC
+
+
+#endif
+
@@ -0,0 +1,562 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "HTCNCGCodeSimulator.h"
+#include "HTCNCProgress.h"
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QObject>
+
+#include <algorithm>
+#include <limits>
+
+#include <math.h>
+
+namespace HTCNC
+{
+	namespace
+	{
+		// Only this many error and warning messages are kept.
+		const int	MAX_MESSAGES( 100 );
+
+		// Progress is checked every this many lines.
+		const int	LINES_PER_UPDATE( 4096 );
+
+		const double	NOT_SET( std::numeric_limits<double>::quiet_NaN() );
+
+		bool isSet( double value )
+		{
+			return value == value;
+		}
+
+		// Parses a number (with optional sign, decimal point and exponent)
+		// and advances p past it.  strtod() isn't used because it follows
+		// the locale's decimal point.
+		bool parseNumber( const char*& p, double& value )
+		{
+			const char*	s( p );
+			bool		negative( false );
+			bool		digits( false );
+			double	result( 0 );
+
+			while ( *s == ' ' || *s == '\t' )
+				++s;
+			if ( *s == '+' || *s == '-' )
+				negative = ( *s++ == '-' );
+
+			for ( ; *s >= '0' && *s <= '9'; ++s )
+			{
+				result = result * 10 + ( *s - '0' );
+				digits = true;
+			}
+			if ( *s == '.' )
+			{
+				double	place( 0.1 );
+
+				for ( ++s; *s >= '0' && *s <= '9'; ++s, place /= 10 )
+				{
+					result += ( *s - '0' ) * place;
+					digits = true;
+				}
+			}
+			if ( ! digits )
+				return false;
+
+			// QString::number() uses exponents for very small values.
+			if ( ( *s == 'e' || *s == 'E' ) &&
+					 ( ( s[1] >= '0' && s[1] <= '9' ) ||
+						 ( ( s[1] == '-' || s[1] == '+' ) && s[2] >= '0' && s[2] <= '9' ) ) )
+			{
+				bool	negative_exponent( s[1] == '-' );
+				int		exponent( 0 );
+
+				s += ( s[1] >= '0' && s[1] <= '9' ) ? 1 : 2;
+				for ( ; *s >= '0' && *s <= '9'; ++s )
+					exponent = exponent * 10 + ( *s - '0' );
+				result *= pow( 10.0, negative_exponent ? -exponent : exponent );
+			}
+
+			value = negative ? -result : result;
+			p = s;
+			return true;
+		}
+	}
+
+
+	GCodeSimulator::Statistics::Statistics()
+		: m_lineCount(0)
+		, m_cutCount(0)
+		, m_rapidCount(0)
+		, m_feedCount(0)
+		, m_toolChangeCount(0)
+		, m_minX(NOT_SET), m_maxX(NOT_SET)
+		, m_minY(NOT_SET), m_maxY(NOT_SET)
+		, m_minZ(NOT_SET), m_maxZ(NOT_SET)
+		, m_minDepth(NOT_SET)
+		, m_maxDepth(NOT_SET)
+		, m_rapidDistance(0)
+		, m_feedDistance(0)
+		, m_feedMinutes(0)
+	{
+	}
+
+
+	GCodeSimulator::GCodeSimulator( const Halftoner::CNCParameters& params )
+		: m_primaryTool( params.m_toolNumber )
+		, m_errorCount(0)
+		, m_warningCount(0)
+		, m_cancelled(false)
+	{
+		ToolShape	shape;
+
+		for ( size_t i = 0; i < params.m_tools.size(); ++i )
+		{
+			shape.m_fullDepth = params.m_tools[i].m_fullToolDepth;
+			shape.m_fullWidth = params.m_tools[i].m_fullToolWidth;
+			m_toolShapes[params.m_tools[i].m_number] = shape;
+		}
+
+		// The primary tool wins if an additional tool has the same number.
+		shape.m_fullDepth = params.m_fullToolDepth;
+		shape.m_fullWidth = params.m_fullToolWidth;
+		m_toolShapes[m_primaryTool] = shape;
+	}
+
+
+	bool GCodeSimulator::run( QIODevice& in, Progress* progress )
+	{
+		qint64	size( in.isSequential() ? 0 : in.size() );
+
+		m_tool = m_nextTool = m_primaryTool;
+		m_rapid = true;
+		m_x = m_y = m_z = NOT_SET;
+		m_feed = 0;
+		m_ended = false;
+		m_cutting = false;
+		m_lineNumber = 0;
+		m_stats = Statistics();
+		m_cuts.clear();
+		m_errors.clear();
+		m_warnings.clear();
+		m_errorCount = m_warningCount = 0;
+		m_cancelled = false;
+
+		while ( ! in.atEnd() )
+		{
+			QByteArray	line( in.readLine() );
+
+			++m_lineNumber;
+			runLine( line.constData() );
+
+			if ( progress && m_lineNumber % LINES_PER_UPDATE == 0 &&
+					 ! progress->update( size > 0 ? int( 1000.0 * in.pos() / size ) : 0, 1000 ) )
+			{
+				m_cancelled = true;
+				return false;
+			}
+		}
+
+		finishCut();
+		m_stats.m_lineCount = m_lineNumber;
+
+		if ( isSet( m_z ) && m_z < 0 )
+			error( QObject::tr("The tool is left below the surface at the end of the program.") );
+		if ( ! m_ended )
+			warning( QObject::tr("The program doesn't end with M30 or M02.") );
+		if ( m_tool != m_primaryTool )
+			warning( QObject::tr("The program ends with tool %1 loaded instead of tool %2.").arg( m_tool ).arg( m_primaryTool ) );
+
+		if ( progress )
+			progress->update( 1, 1 );
+
+		return m_errorCount == 0;
+	}
+
+
+	void GCodeSimulator::runLine( const char* line )
+	{
+		const char*	p( line );
+		double	x( NOT_SET ), y( NOT_SET ), z( NOT_SET );
+		bool		tool_change( false );
+
+		while ( *p )
+		{
+			char	c( *p );
+
+			if ( c == ' ' || c == '\t' || c == '\r' || c == '\n' )
+			{
+				++p;
+				continue;
+			}
+
+			// Comments and the program delimiter.
+			if ( c == '(' )
+			{
+				while ( *p && *p != ')' )
+					++p;
+				if ( *p )
+					++p;
+				continue;
+			}
+			if ( c == ';' || c == '%' )
+				break;
+
+			if ( c >= 'a' && c <= 'z' )
+				c = c - 'a' + 'A';
+			if ( c < 'A' || c > 'Z' )
+			{
+				error( QObject::tr("Unexpected character '%1'.").arg( QChar( *p ) ) );
+				return;
+			}
+
+			double	value;
+
+			++p;
+			if ( ! parseNumber( p, value ) )
+			{
+				error( QObject::tr("%1 is not followed by a number.").arg( QChar( c ) ) );
+				return;
+			}
+
+			int	code( int( floor( value + 0.5 ) ) );
+
+			switch ( c )
+			{
+				case 'G':
+					switch ( code )
+					{
+						case 0:
+							m_rapid = true;
+							break;
+						case 1:
+							m_rapid = false;
+							break;
+						case 2:
+						case 3:
+							error( QObject::tr("Arcs (G%1) are not supported.").arg( code ) );
+							break;
+						case 91:
+							error( QObject::tr("Relative positioning (G91) is not supported.") );
+							break;
+						case 17:	// XY plane
+						case 20:	// Inches
+						case 21:	// Millimeters
+						case 40:	// Cutter compensation off
+						case 43:	// Tool length offset
+						case 49:	// Tool length offset off
+						case 54:	// Work coordinates
+						case 80:	// Canned cycle off
+						case 90:	// Absolute positioning
+						case 94:	// Units per minute feed
+							break;
+						default:
+							warning( QObject::tr("G%1 is not supported and was ignored.").arg( code ) );
+							break;
+					}
+					break;
+
+				case 'M':
+					switch ( code )
+					{
+						case 2:
+						case 30:
+							m_ended = true;
+							break;
+						case 6:
+							tool_change = true;
+							break;
+						case 0:		// Pause
+						case 1:
+						case 3:		// Spindle
+						case 4:
+						case 5:
+						case 7:		// Coolant
+						case 8:
+						case 9:
+							break;
+						default:
+							warning( QObject::tr("M%1 is not supported and was ignored.").arg( code ) );
+							break;
+					}
+					break;
+
+				case 'X':
+					x = value;
+					break;
+				case 'Y':
+					y = value;
+					break;
+				case 'Z':
+					z = value;
+					break;
+				case 'F':
+					m_feed = value;
+					break;
+				case 'T':
+					m_nextTool = code;
+					break;
+				case 'H':	// Tool length offset number
+				case 'N':	// Line number
+				case 'S':	// Spindle speed
+					break;
+				default:
+					warning( QObject::tr("%1 words are not supported and were ignored.").arg( QChar( c ) ) );
+					break;
+			}
+		}
+
+		if ( tool_change )
+		{
+			finishCut();
+			if ( isSet( m_z ) && m_z < 0 )
+				error( QObject::tr("Tool change with the tool below the surface.") );
+			if ( m_toolShapes.find( m_nextTool ) == m_toolShapes.end() )
+				warning( QObject::tr("Tool %1 is not a known tool; its cuts are treated as if made by tool %2.").arg( m_nextTool ).arg( m_primaryTool ) );
+			m_tool = m_nextTool;
+			++m_stats.m_toolChangeCount;
+		}
+
+		if ( isSet( x ) || isSet( y ) || isSet( z ) )
+		{
+			if ( m_ended )
+				warning( QObject::tr("Move after the end of the program.") );
+			move( m_rapid, x, y, z );
+		}
+	}
+
+
+	void GCodeSimulator::move( bool rapid, double x, double y, double z )
+	{
+		double	nx( isSet( x ) ? x : m_x );
+		double	ny( isSet( y ) ? y : m_y );
+		double	nz( isSet( z ) ? z : m_z );
+		bool		sideways( ( isSet( x ) && x != m_x ) || ( isSet( y ) && y != m_y ) );
+
+		if ( sideways )
+		{
+			if ( ! isSet( m_z ) )
+				warning( QObject::tr("Sideways move before the tool height is set.") );
+			else if ( m_z < 0 || nz < 0 )
+				error( QObject::tr("Sideways move below the surface (Z%1).").arg( qMin( m_z, nz ) ) );
+			finishCut();
+		}
+
+		if ( rapid && nz < 0 && ( ! isSet( m_z ) || nz < m_z ) )
+			error( QObject::tr("Rapid move into the material (Z%1).").arg( nz ) );
+
+		if ( isSet( m_x ) && isSet( m_y ) && isSet( m_z ) )
+		{
+			double	dx( nx - m_x ), dy( ny - m_y ), dz( nz - m_z );
+			double	distance( sqrt( dx * dx + dy * dy + dz * dz ) );
+
+			if ( rapid )
+			{
+				m_stats.m_rapidDistance += distance;
+			}
+			else
+			{
+				m_stats.m_feedDistance += distance;
+				if ( m_feed > 0 )
+					m_stats.m_feedMinutes += distance / m_feed;
+			}
+		}
+
+		if ( rapid )
+			++m_stats.m_rapidCount;
+		else
+			++m_stats.m_feedCount;
+
+		if ( isSet( nx ) )
+		{
+			m_stats.m_minX = isSet( m_stats.m_minX ) ? qMin( m_stats.m_minX, nx ) : nx;
+			m_stats.m_maxX = isSet( m_stats.m_maxX ) ? qMax( m_stats.m_maxX, nx ) : nx;
+		}
+		if ( isSet( ny ) )
+		{
+			m_stats.m_minY = isSet( m_stats.m_minY ) ? qMin( m_stats.m_minY, ny ) : ny;
+			m_stats.m_maxY = isSet( m_stats.m_maxY ) ? qMax( m_stats.m_maxY, ny ) : ny;
+		}
+		if ( isSet( nz ) )
+		{
+			m_stats.m_minZ = isSet( m_stats.m_minZ ) ? qMin( m_stats.m_minZ, nz ) : nz;
+			m_stats.m_maxZ = isSet( m_stats.m_maxZ ) ? qMax( m_stats.m_maxZ, nz ) : nz;
+		}
+
+		m_x = nx;
+		m_y = ny;
+		m_z = nz;
+
+		if ( ! rapid && m_z < 0 )
+		{
+			if ( ! isSet( m_x ) || ! isSet( m_y ) )
+			{
+				error( QObject::tr("Cut before the X/Y position is set.") );
+			}
+			else if ( ! m_cutting )
+			{
+				// Pecks at the same spot are all part of one cut.
+				m_cutting = true;
+				m_cut.m_x = m_x;
+				m_cut.m_y = m_y;
+				m_cutDepth = -m_z;
+			}
+			else
+			{
+				m_cutDepth = qMax( m_cutDepth, -m_z );
+			}
+		}
+	}
+
+
+	void GCodeSimulator::finishCut()
+	{
+		if ( ! m_cutting )
+			return;
+
+		std::map<int, ToolShape>::const_iterator	it( m_toolShapes.find( m_tool ) );
+
+		if ( it == m_toolShapes.end() )
+			it = m_toolShapes.find( m_primaryTool );
+
+		const ToolShape&	shape( it->second );
+		double	depth( m_cutDepth );
+
+		if ( depth > shape.m_fullDepth + 1e-9 )
+		{
+			error( QObject::tr("The cut at X%1 Y%2 is %3 deep, but tool %4 can only cut %5 deep.")
+				.arg( m_cut.m_x ).arg( m_cut.m_y ).arg( depth ).arg( m_tool ).arg( shape.m_fullDepth ) );
+			depth = shape.m_fullDepth;
+		}
+
+		// A V-bit's cut widens in proportion to its depth.
+		m_cut.m_diameter = shape.m_fullDepth > 0 ? depth * shape.m_fullWidth / shape.m_fullDepth : 0;
+		m_cuts.push_back( m_cut );
+
+		++m_stats.m_cutCount;
+		m_stats.m_minDepth = isSet( m_stats.m_minDepth ) ? qMin( m_stats.m_minDepth, m_cutDepth ) : m_cutDepth;
+		m_stats.m_maxDepth = isSet( m_stats.m_maxDepth ) ? qMax( m_stats.m_maxDepth, m_cutDepth ) : m_cutDepth;
+
+		m_cutting = false;
+	}
+
+
+	void GCodeSimulator::error( const QString& message )
+	{
+		if ( ++m_errorCount <= MAX_MESSAGES )
+			m_errors << QObject::tr("Line %1: %2").arg( m_lineNumber ).arg( message );
+	}
+
+
+	void GCodeSimulator::warning( const QString& message )
+	{
+		if ( ++m_warningCount <= MAX_MESSAGES )
+			m_warnings << QObject::tr("Line %1: %2").arg( m_lineNumber ).arg( message );
+	}
+
+
+	QString GCodeSimulator::getSummary() const
+	{
+		QString	summary;
+
+		summary += QObject::tr("Lines: %1\n").arg( m_stats.m_lineCount );
+		summary += QObject::tr("Cuts: %1\n").arg( m_stats.m_cutCount );
+		if ( m_stats.m_cutCount > 0 )
+			summary += QObject::tr("Cut depth: %1 to %2\n").arg( m_stats.m_minDepth ).arg( m_stats.m_maxDepth );
+		summary += QObject::tr("Tool changes: %1\n").arg( m_stats.m_toolChangeCount );
+		if ( isSet( m_stats.m_minX ) && isSet( m_stats.m_minY ) && isSet( m_stats.m_minZ ) )
+		{
+			summary += QObject::tr("X: %1 to %2\n").arg( m_stats.m_minX ).arg( m_stats.m_maxX );
+			summary += QObject::tr("Y: %1 to %2\n").arg( m_stats.m_minY ).arg( m_stats.m_maxY );
+			summary += QObject::tr("Z: %1 to %2\n").arg( m_stats.m_minZ ).arg( m_stats.m_maxZ );
+		}
+		summary += QObject::tr("Rapid moves: %1, covering %2\n").arg( m_stats.m_rapidCount ).arg( m_stats.m_rapidDistance );
+		summary += QObject::tr("Feed moves: %1, covering %2 (%3 minutes at the programmed feed)\n")
+			.arg( m_stats.m_feedCount ).arg( m_stats.m_feedDistance ).arg( m_stats.m_feedMinutes );
+
+		summary += QObject::tr("Errors: %1\n").arg( m_errorCount );
+		for ( int i = 0; i < m_errors.size(); ++i )
+			summary += "  " + m_errors[i] + "\n";
+		summary += QObject::tr("Warnings: %1\n").arg( m_warningCount );
+		for ( int i = 0; i < m_warnings.size(); ++i )
+			summary += "  " + m_warnings[i] + "\n";
+
+		return summary;
+	}
+
+
+	QImage GCodeSimulator::render( int maxSize ) const
+	{
+		if ( m_cuts.empty() || maxSize < 1 )
+			return QImage();
+
+		double	left( m_cuts[0].m_x ), right( left );
+		double	bottom( m_cuts[0].m_y ), top( bottom );
+
+		for ( size_t i = 0; i < m_cuts.size(); ++i )
+		{
+			double	r( m_cuts[i].m_diameter / 2 );
+
+			left = std::min( left, m_cuts[i].m_x - r );
+			right = std::max( right, m_cuts[i].m_x + r );
+			bottom = std::min( bottom, m_cuts[i].m_y - r );
+			top = std::max( top, m_cuts[i].m_y + r );
+		}
+
+		double	extent( std::max( right - left, top - bottom ) );
+		double	scale( extent > 0 ? maxSize / extent : 1 );
+		QImage	image( std::max( 1, int( ceil( ( right - left ) * scale ) ) ),
+									 std::max( 1, int( ceil( ( top - bottom ) * scale ) ) ),
+									 QImage::Format_RGB32 );
+
+		image.fill( qRgb( 0, 0, 0 ) );
+
+		// Same look as the Halftoner's preview.  Y increases up the page in
+		// g code but down the image.
+		for ( size_t i = 0; i < m_cuts.size(); ++i )
+		{
+			double	x( ( m_cuts[i].m_x - left ) * scale );
+			double	y( ( top - m_cuts[i].m_y ) * scale );
+			double	r( m_cuts[i].m_diameter / 2 * scale );
+			double	r2( r * r );
+			int			x0( std::max( 0, int( floor( x - r ) ) ) );
+			int			x1( std::min( image.width(), int( ceil( x + r ) ) ) );
+			int			y0( std::max( 0, int( floor( y - r ) ) ) );
+			int			y1( std::min( image.height(), int( ceil( y + r ) ) ) );
+
+			for ( int j = y0; j < y1; ++j )
+			{
+				QRgb*	line( reinterpret_cast<QRgb*>( image.scanLine( j ) ) );
+				double	dy( j - y );
+
+				for ( int k = x0; k < x1; ++k )
+				{
+					double	dx( k - x );
+					double	d2( dx * dx + dy * dy );
+
+					if ( d2 < r2 - 0.5 )
+						line[k] = qRgb( 255, 255, 255 );
+					else if ( d2 < r2 + 0.5 && line[k] != qRgb( 255, 255, 255 ) )
+						line[k] = qRgb( 127, 127, 127 );
+				}
+			}
+		}
+
+		return image;
+	}
+}
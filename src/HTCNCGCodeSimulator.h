@@ -0,0 +1,196 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#ifndef HTCNCGCODESIMULATOR_H
+#define HTCNCGCODESIMULATOR_H
+
+#include "HTCNCHalftoner.h"
+
+#include <QImage>
+#include <QString>
+#include <QStringList>
+
+#include <map>
+#include <vector>
+
+// Forward decls
+class QIODevice;
+
+namespace HTCNC
+{
+	class Progress;
+
+	/*@brief Runs a g code program through a simple model of the machine to
+	 * check it and to show what it will cut.
+	 *
+	 * The program is read a line at a time, so files of any size can be
+	 * checked.  Only the subset of g code that the Halftoner produces (plus
+	 * the usual preamble commands) is understood: absolute G00/G01 moves,
+	 * tool changes and the program/spindle/coolant M codes.
+	 *
+	 * Each plunge below Z=0 is treated as a V-bit cut; its diameter follows
+	 * from the depth and the geometry of the tool that is loaded (see the
+	 * diagram in HTCNCHalftoner.h).  Sideways moves below the surface, rapid
+	 * moves into the material and cuts deeper than the tool are reported as
+	 * errors.
+	 **/
+	class GCodeSimulator
+	{
+		public:
+			/// What the program does, in program units.
+			struct Statistics
+			{
+				Statistics();
+
+				int			m_lineCount;
+				int			m_cutCount;					/// Number of distinct plunges below Z=0
+				int			m_rapidCount;				/// Number of G00 moves
+				int			m_feedCount;				/// Number of G01 moves
+				int			m_toolChangeCount;
+				double	m_minX, m_maxX;			/// Extents of every position visited
+				double	m_minY, m_maxY;
+				double	m_minZ, m_maxZ;
+				double	m_minDepth;					/// Shallowest cut (as a positive depth)
+				double	m_maxDepth;					/// Deepest cut (as a positive depth)
+				double	m_rapidDistance;		/// Total length of the G00 moves
+				double	m_feedDistance;			/// Total length of the G01 moves
+				double	m_feedMinutes;			/// Time spent on G01 moves at the programmed feed
+			};
+
+			/**
+			 * @brief Constructs a simulator.
+			 * @param params Describes the primary tool (m_toolNumber,
+			 * m_fullToolDepth, m_fullToolWidth), which is assumed to be loaded
+			 * at the start of the program, and any additional tools.
+			 **/
+			GCodeSimulator( const Halftoner::CNCParameters& params );
+
+			/**
+			 * @brief Runs a program.
+			 * @param in The program.  It is read a line at a time from its
+			 * current position to its end.
+			 * @param progress If not null, is kept up to date (if the size of
+			 * in is known) and checked for cancellation.
+			 * @return true if the program ran to the end without errors.
+			 **/
+			bool run( QIODevice& in, Progress* progress = 0 );
+
+			/// Returns true if the last run was cancelled.
+			bool wasCancelled() const
+			{
+				return m_cancelled;
+			}
+
+			const Statistics& getStatistics() const
+			{
+				return m_stats;
+			}
+
+			/// Returns the total number of errors (only the first few are kept
+			/// as messages).
+			int getErrorCount() const
+			{
+				return m_errorCount;
+			}
+
+			int getWarningCount() const
+			{
+				return m_warningCount;
+			}
+
+			/// Returns the first few error messages.
+			const QStringList& getErrors() const
+			{
+				return m_errors;
+			}
+
+			/// Returns the first few warning messages.
+			const QStringList& getWarnings() const
+			{
+				return m_warnings;
+			}
+
+			/// Returns a readable summary of the statistics, errors and warnings.
+			QString getSummary() const;
+
+			/**
+			 * @brief Draws the cuts as white circles on black, as seen from above.
+			 * @param maxSize The size of the longer side of the image, in pixels.
+			 **/
+			QImage render( int maxSize ) const;
+
+		private:
+			/// A single plunge.
+			struct Cut
+			{
+				double	m_x;
+				double	m_y;
+				double	m_diameter;
+			};
+
+			/// The cutting geometry of a tool.
+			struct ToolShape
+			{
+				double	m_fullDepth;
+				double	m_fullWidth;
+			};
+
+			/// Runs one line of the program.  line must be nul-terminated.
+			void runLine( const char* line );
+
+			/// Moves the tool.  Coordinates that aren't given are NaN.
+			void move( bool rapid, double x, double y, double z );
+
+			/// Closes off the cut in progress, if any.
+			void finishCut();
+
+			void error( const QString& message );
+			void warning( const QString& message );
+
+			/// The shapes of the known tools, by tool number.
+			std::map<int, ToolShape>	m_toolShapes;
+			int			m_primaryTool;
+
+			// Machine state
+			int			m_tool;						/// The loaded tool
+			int			m_nextTool;				/// The tool selected by the last T word
+			bool		m_rapid;					/// True if G00 is the motion mode
+			double	m_x, m_y, m_z;		/// NaN until first set
+			double	m_feed;
+			bool		m_ended;					/// True once M02/M30 is seen
+
+			// The cut in progress
+			bool		m_cutting;
+			Cut			m_cut;
+			double	m_cutDepth;
+
+			int			m_lineNumber;
+			Statistics	m_stats;
+			std::vector<Cut>	m_cuts;
+			QStringList	m_errors;
+			QStringList	m_warnings;
+			int			m_errorCount;
+			int			m_warningCount;
+			bool		m_cancelled;
+	};
+
+}	// namespace HTCNC
+
+
+#endif
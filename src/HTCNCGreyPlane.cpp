@@ -0,0 +1,93 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "HTCNCGreyPlane.h"
+
+#include <QImage>
+
+#include <algorithm>
+
+namespace HTCNC
+{
+	GreyPlane::GreyPlane()
+		: m_width( 0 )
+		, m_height( 0 )
+		, m_stride( 0 )
+		, m_data( 0 )
+	{
+	}
+
+
+	GreyPlane::GreyPlane( const QImage& src )
+		: m_width( src.width() )
+		, m_height( src.height() )
+		, m_stride( ( src.width() + ALIGNMENT - 1 ) / ALIGNMENT * ALIGNMENT )
+		, m_buffer( m_stride * m_height + ALIGNMENT, 0 )
+	{
+		// Start the first row on a boundary; the stride keeps the rest there.
+		quintptr	address( reinterpret_cast<quintptr>( &m_buffer[0] ) );
+
+		m_data = &m_buffer[0] + ( ALIGNMENT - address % ALIGNMENT ) % ALIGNMENT;
+
+		RowConverter	converter( src );
+
+		for ( int y = 0; y < m_height; ++y )
+			converter.convert( y, m_data + y * m_stride );
+	}
+
+
+	GreyPlane::RowConverter::RowConverter( const QImage& src )
+		: m_src( src )
+	{
+		std::fill( m_intensity, m_intensity + 256, 0 );
+		if ( src.format() == QImage::Format_Indexed8 )
+		{
+			for ( int i = 0; i < std::min( 256, src.numColors() ); ++i )
+				m_intensity[i] = static_cast<unsigned char>( qGray( src.color( i ) ) );
+		}
+	}
+
+
+	void GreyPlane::RowConverter::convert( int y, unsigned char* dest ) const
+	{
+		const int	width( m_src.width() );
+
+		// 32-bit images can be read a line at a time, and indexed ones
+		// through the intensities of their color tables; anything else goes
+		// through pixel().
+		if ( m_src.format() == QImage::Format_RGB32 || m_src.format() == QImage::Format_ARGB32 )
+		{
+			const QRgb*	line( reinterpret_cast<const QRgb*>( m_src.scanLine( y ) ) );
+
+			for ( int x = 0; x < width; ++x )
+				dest[x] = static_cast<unsigned char>( qGray( line[x] ) );
+		}
+		else if ( m_src.format() == QImage::Format_Indexed8 )
+		{
+			const uchar*	line( m_src.scanLine( y ) );
+
+			for ( int x = 0; x < width; ++x )
+				dest[x] = m_intensity[line[x]];
+		}
+		else
+		{
+			for ( int x = 0; x < width; ++x )
+				dest[x] = static_cast<unsigned char>( qGray( m_src.pixel( x, y ) ) );
+		}
+	}
+}
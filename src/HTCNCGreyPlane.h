@@ -0,0 +1,112 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#ifndef HTCNCGREYPLANE_H
+#define HTCNCGREYPLANE_H
+
+#include <vector>
+
+// Forward decls
+class QImage;
+
+namespace HTCNC
+{
+
+	/*@brief The greyscale intensities of an image, one byte per pixel.
+	 *
+	 * The Halftoner converts its source to one of these once, and every
+	 * later stage reads it a row at a time instead of going back to the
+	 * 32-bit image through QImage::pixel().  Rows are stored one after the
+	 * other, each starting on an ALIGNMENT byte boundary and padded with
+	 * zeros to a multiple of ALIGNMENT bytes.
+	 **/
+	class GreyPlane
+	{
+		public:
+			/// Row alignment in bytes: a cache line.
+			enum { ALIGNMENT = 64 };
+
+			/// Constructs an empty plane.
+			GreyPlane();
+
+			/// Converts an image.
+			GreyPlane( const QImage& src );
+
+			int getWidth() const
+			{
+				return m_width;
+			}
+
+			int getHeight() const
+			{
+				return m_height;
+			}
+
+			/// Returns the distance between the starts of rows, in bytes.
+			int getStride() const
+			{
+				return m_stride;
+			}
+
+			/// Returns the intensities of row y.
+			const unsigned char* getRow( int y ) const
+			{
+				return m_data + y * m_stride;
+			}
+
+			/*@brief Converts an image to intensities in the range [0..255], a
+			 * row at a time.
+			 *
+			 * The intensities of an indexed image's color table are worked out
+			 * once, when the converter is constructed.
+			 **/
+			class RowConverter
+			{
+				public:
+					/// The image must outlive the converter.
+					RowConverter( const QImage& src );
+
+					/**
+					 * @brief Converts one row.
+					 * @param y The row.
+					 * @param dest Receives src.width() intensities.
+					 **/
+					void convert( int y, unsigned char* dest ) const;
+
+				private:
+					const QImage&	m_src;
+					unsigned char	m_intensity[256];	/// Intensity of each color table entry
+			};
+
+		private:
+			// Not copyable; m_data points into m_buffer.
+			GreyPlane( const GreyPlane& );
+			GreyPlane& operator=( const GreyPlane& );
+
+			int	m_width;
+			int	m_height;
+			int	m_stride;
+			std::vector<unsigned char>	m_buffer;
+			unsigned char*	m_data;		/// The first row, within m_buffer
+	};
+
+}	// namespace HTCNC
+
+
+#endif
@@ -17,149 +17,217 @@
 ******************************************************************************/
 
 #include "HTCNCHalftoner.h"
+#include "HTCNCBlockPyramid.h"
+#include "HTCNCDepthMap.h"
+#include "HTCNCDotField.h"
+#include "HTCNCDotModulator.h"
+#include "HTCNCGreyPlane.h"
+#include "HTCNCIntegralImage.h"
+#include "HTCNCJobPlanner.h"
+#include "HTCNCKernels.h"
+#include "HTCNCLattice.h"
+#include "HTCNCProgress.h"
 
 #include <QImage>
 #include <QPixmap>
 
+#include <algorithm>
+#include <limits>
+
 #include <math.h>
 
 namespace HTCNC
 {
-	// Returns the dot size for a given point in an image.  The returned value
-	// is in the range [0..1].  The dot size is determined by averaging the 
-	// greyscale intensity of each pixel within a square boundary around the point.
-	// radius is the number of pixels to consider around (x,y).  For example,
-	// a radius of 2 would mean that all pixels in the range [(x-2, y-2)..(x+1, y+1)]
-	// would be averaged to determine the final dot size.  Note that the
-	// radius determines a square (not a circle) around the point that is
-	// being queried.
-	double getDotSize( const QImage& src, int x, int y, int radius )
+	Halftoner::MoveStatistics::MoveStatistics()
+		: m_minX( std::numeric_limits<double>::quiet_NaN() )
+		, m_maxX( std::numeric_limits<double>::quiet_NaN() )
+		, m_minY( std::numeric_limits<double>::quiet_NaN() )
+		, m_maxY( std::numeric_limits<double>::quiet_NaN() )
+		, m_minZ( std::numeric_limits<double>::quiet_NaN() )
+		, m_maxZ( std::numeric_limits<double>::quiet_NaN() )
+		, m_rapidCount(0)
+		, m_feedCount(0)
+		, m_rapidDistance(0)
+	{
+	}
+
+
+	Halftoner::Halftoner( const QPixmap& src, QImage& dest, int scale, bool generateGCode, const CNCParameters& params, Progress* progress )
+		: m_cutCount(0)
+		, m_cancelled(false)
 	{
-		int	total_intensity = 0;
-		int	pix_count = 0;
+		halftone( src.toImage(), dest, scale, generateGCode, params, progress );
+	}
+
+
+	Halftoner::Halftoner( const QImage& src, QImage& dest, int scale, bool generateGCode, const CNCParameters& params, Progress* progress )
+		: m_cutCount(0)
+		, m_cancelled(false)
+	{
+		halftone( src, dest, scale, generateGCode, params, progress );
+	}
+
+
+	// How the progress of a run is divided between its passes, in tenths of
+	// a percent.
+	static const int	PROGRESS_SAMPLED( 400 );
+	static const int	PROGRESS_MODULATED( 550 );
+	static const int	PROGRESS_DRAWN( 800 );
+	static const int	PROGRESS_TOTAL( 1000 );
+
 
-		for ( int i = x - radius; i < x + radius; ++i )
+	void Halftoner::halftone( const QImage& src_img, QImage& dest, int scale, bool generateGCode, const CNCParameters& params, Progress* progress )
+	{
+		DepthMap	depth_map( params.m_depthLevels, params.m_gamma );
+		Lattice		lattice( params, src_img.width(), src_img.height() );
+		const std::vector<Lattice::Cell>&	cells( lattice.getCells() );
+		double	radius( lattice.getDotRadius() );
+
+		// Basic approach: Lay the lattice over the source image and convert
+		// each cell to a circle in the destination image and a tool cut in the
+		// g code.
+		//
+		// First pass: sample the mean intensity of every cell so the dot
+		// modulator can look at neighboring cells.  Grid positions without a
+		// cell are left at -1.
+		int	columns( lattice.getColumns() );
+		std::vector<int>	intensities( lattice.getRows() * columns, -1 );
+		std::vector<int>	levels;
+
+		// Every stage below reads the source's intensities a row at a time,
+		// so it is converted to one byte per pixel just once.
+		GreyPlane	plane( src_img );
+
+		// Cells that fall entirely within a uniform block of the image don't
+		// need their pixels averaged.
+		BlockPyramid	pyramid( plane );
+		// A lattice fitted to an output size samples fractional areas, which
+		// the integral image averages exactly (it is left empty otherwise).
+		GreyPlane			no_plane;
+		IntegralImage	integral( lattice.isFitted() ? plane : no_plane );
+		std::vector<int>	cell_index( intensities.size(), -1 );
+		// Otherwise each cell averages a step x step block.
+		BlockMeanFunction	block_mean( getBlockMeanFunction( params.m_step ) );
+
+		for ( size_t k = 0; k < cells.size(); ++k )
 		{
-			for ( int j = y - radius; j < y + radius; ++j )
-			{
-				// Bounds checking.
-				if ( i >= 0 && i < src.width() && 
-						 j >= 0 && j < src.height() )
-				{
-					int gray( qGray(src.pixel( i, j )) );
+			const Lattice::Cell&	cell( cells[k] );
+			int	idx( cell.m_row * columns + cell.m_column );
+			int	value;
 
-					total_intensity += gray;
-					++pix_count;
-				}
+			// Check in at the start of each row.
+			if ( progress && ( k == 0 || cell.m_row != cells[k-1].m_row ) &&
+					 ! progress->update( int( double( PROGRESS_SAMPLED ) * k / cells.size() ), PROGRESS_TOTAL ) )
+			{
+				abandon();
+				return;
 			}
+
+			if ( pyramid.isUniform( cell.m_left, cell.m_top, cell.m_right, cell.m_bottom, value ) )
+				intensities[idx] = value;
+			else if ( lattice.isFitted() )
+				intensities[idx] = int( integral.getMean( cell.m_sampleLeft, cell.m_sampleTop, cell.m_sampleRight, cell.m_sampleBottom ) + 1e-9 );
+			else
+				intensities[idx] = block_mean( plane, cell );
+			cell_index[idx] = static_cast<int>( k );
 		}
 
-		return ( total_intensity / pix_count / 255.0 ); 
-	}
+		DotModulator	modulator( params.m_modulation, depth_map, params.m_maxThreads );
 
+		if ( ! modulator.modulate( intensities, columns, levels,
+															 ProgressStage( progress, PROGRESS_SAMPLED, PROGRESS_MODULATED, PROGRESS_TOTAL ) ) ||
+				 ( progress && ! progress->update( PROGRESS_MODULATED, PROGRESS_TOTAL ) ) )
+		{
+			abandon();
+			return;
+		}
 
-	Halftoner::Halftoner( const QPixmap& src, QImage& dest, int scale, bool generateGCode, const CNCParameters& params )
-		: m_cutCount(0)
-	{
-		QImage	src_img( src.toImage() );
-		int offset = params.m_step/2;
-		int radius = params.m_step/2;
-		double	max_dot_size( params.m_fullToolWidth * params.m_maxCutPercent );
-		double	scale_factor( scale );
-		bool		write_y(true);
-
-		dest.fill( qRgb(0, 0, 0 ) );
-
-		// Basic approach: Step through the source image and convert each 
-		// point to a circle in the destination image and a tool cut in the
-		// g code.  Every other row is offset by half a step to achieve the 
-		// zig-zag pattern of a typical halftone image.
-		for ( int y = params.m_step/2, cy = src_img.height()/params.m_step; y < src_img.height(); y+=params.m_step, --cy, write_y = true )
+		// Second pass: draw and record the dots.  Only the runs of cells that
+		// have a dot are visited; the destination starts out black, so the
+		// rest of the image needs no drawing at all.
+		DotField	field( levels, lattice.getRows(), columns );
+
+		bool	draw( ! dest.isNull() );
+		DotRenderer	renderer( dest, radius, scale );
+
+		if ( draw )
+			dest.fill( dest.format() == QImage::Format_Indexed8 ? 0 : qRgb(0, 0, 0 ) );
+
+		for ( int r = 0; r < field.getRows(); ++r )
 		{
-			for ( int x = offset, cx = 1; x < src_img.width(); x+=params.m_step, ++cx )
+			if ( progress &&
+					 ! progress->update( PROGRESS_MODULATED + ( PROGRESS_DRAWN - PROGRESS_MODULATED ) * r / field.getRows(), PROGRESS_TOTAL ) )
+			{
+				abandon();
+				return;
+			}
+
+			for ( int run = field.getRowStart( r ); run < field.getRowStart( r + 1 ); ++run )
 			{
-				double ds( getDotSize( src_img, x, y, radius ) );
+				const DotField::Run&	dot_run( field.getRun( run ) );
+				double	ds( depth_map.getDotSize( dot_run.m_level ) );
 
-				// Simple optimization: if the dot size is zero, just fill the destination
-				// area with black pixels and don't generate any g code.
 				if ( ds == 0 )
+					continue;
+
+				for ( int c = dot_run.m_column; c < dot_run.m_column + dot_run.m_length; ++c )
 				{
-					for ( int i =  scale_factor*(x - radius); i < scale_factor*(x + radius); ++i )
-					{
-						for ( int j = scale_factor*(y - radius); j < scale_factor*(y + radius); ++j )
-						{
-							if ( i >= 0 && i < dest.width() && j >= 0 && j < dest.height() )
-							{
-								dest.setPixel( i, j, qRgb( 0, 0, 0 ) );
-							}
-						}
-					}
-				}
-				else
-				{
-					// Draw a circle and generate some tool movement g code.
+					const Lattice::Cell&	cell( cells[cell_index[r * columns + c]] );
 
+					// Draw a circle and generate some tool movement g code.
 					++m_cutCount;
 
 					if ( generateGCode )
 					{
-						// Write the g code to cut this dot.
-						// Lift tool to safe 'fast z' depth.
-						m_gCode += "G00Z" + QString::number( params.m_fastZ ) + "\n";
-					
-						// Move tool to cut location.
-						double cut_x( cx * ( max_dot_size + params.m_minDotGap ) );
-
-						if ( offset )
-							cut_x -= max_dot_size / 2.0;
-						m_gCode += "G00X" + QString::number( cut_x ); 
-						if ( write_y )
-						{
-							double cut_y( cy * ( max_dot_size + params.m_minDotGap ) );
-							m_gCode += "Y" + QString::number( cut_y ); 
-							write_y = false;
-						}
-						m_gCode += "\n";
-					
-						// Move tool to cut depth.
-						m_gCode += "G01Z" +
-							QString::number( - params.m_fullToolDepth * params.m_maxCutPercent * ds ) + 
-							"\n";
+						// Record the dot; the job planner turns these into g code.
+						Dot	dot;
+
+						dot.m_x = cell.m_cutX;
+						dot.m_y = cell.m_cutY;
+						dot.m_size = ds;
+						dot.m_level = dot_run.m_level;
+						dot.m_row = cell.m_row;
+						m_dots.push_back( dot );
 					}
 
-					// Draw a circle in the preview image.
-					double	ds2( radius*radius*ds*ds*scale_factor*scale_factor );
-					for ( int i = scale_factor*(x - radius); i < scale_factor*(x + radius); ++i )
-					{
-						for ( int j = scale_factor*(y - radius); j < scale_factor*(y + radius); ++j )
-						{
-							if ( i >= 0 && i < dest.width() && j >= 0 && j < dest.height() )
-							{
-								int dx( i - scale_factor*x ), dy( j - scale_factor*y );
-
-								if ( dx * dx + dy * dy < ds2 - 0.5 )
-									dest.setPixel(i, j, qRgb(255, 255, 255) );
-								// Make the border pixels grey to improve the appearance a bit.
-								else if ( dx * dx + dy * dy < ds2 + 0.5 )
-									dest.setPixel(i, j, qRgb(127, 127, 127) );
-								else
-								{
-									dest.setPixel(i, j, qRgb(0, 0, 0) );
-								}
-							}
-						}
-					}
+					if ( draw )
+						renderer.draw( cell, dot_run.m_level, ds );
 				}
 			}
-			// Zig-zag in x.
-			if ( offset )
-				offset = 0;
-			else
-				offset = params.m_step/2;
 		}
-		// Finally, make sure the tool is parked at a safe depth.
-		m_gCode += "G00Z" + QString::number( params.m_fastZ ); // Lift tool to safe 'fast z' depth.
-		m_gCode += "\n";
+
+		if ( progress && ! progress->update( PROGRESS_DRAWN, PROGRESS_TOTAL ) )
+		{
+			abandon();
+			return;
+		}
+
+		if ( generateGCode )
+		{
+			JobPlanner	planner( params );
+
+			m_gCode = planner.generate( m_dots, &m_moveStatistics,
+																	ProgressStage( progress, PROGRESS_DRAWN, PROGRESS_TOTAL, PROGRESS_TOTAL ) );
+			if ( progress && progress->isCancelled() )
+			{
+				abandon();
+				return;
+			}
+			m_travelErrors = JobPlanner::checkTravel( m_moveStatistics, params.m_travelLimits );
+		}
+
+		if ( progress )
+			progress->update( PROGRESS_TOTAL, PROGRESS_TOTAL );
 	}
-}
 
+
+	void Halftoner::abandon()
+	{
+		m_cancelled = true;
+		m_cutCount = 0;
+		m_dots.clear();
+		m_gCode.clear();
+		m_moveStatistics = MoveStatistics();
+		m_travelErrors.clear();
+	}
+}
@@ -21,6 +21,9 @@
 #define HTCNCHALFTONER_H
 
 #include <QString>
+#include <QStringList>
+
+#include <vector>
 
 // Forward decls
 class QPixmap;
@@ -28,6 +31,7 @@ class QImage;
 
 namespace HTCNC
 {
+	class Progress;
 
 	/*@brief Converts arbitrary images to halftone images as well as CNC instructions.
 	 **/
@@ -54,30 +58,161 @@ namespace HTCNC
 			//       Width
 			//
 			//
-			typedef struct
+			/// Identifies the version of the halftoning and g code generation.
+			/// Bump it with any change that can alter the output for the same
+			/// image and settings, so output cached by older versions isn't reused.
+			static const int GENERATOR_VERSION = 5;
+
+			/// The strategies for turning cell intensities into dot sizes.
+			typedef enum
+			{
+				BOX_MEAN,					/// Each cell's mean intensity, independently
+				FLOYD_STEINBERG,	/// Floyd-Steinberg error diffusion between cells
+				JARVIS,						/// Jarvis-Judice-Ninke error diffusion between cells
+				ORDERED,					/// Ordered (Bayer matrix) thresholding
+				NOISE							/// Noise pattern thresholding
+			} Modulation;
+
+			/// The layouts of the halftone cells.
+			typedef enum
+			{
+				OFFSET_ROWS,	/// Square grid with every other row offset by half a step
+				SQUARE,				/// Square grid
+				HEXAGONAL,		/// Hexagonal packing
+				ROTATED				/// Square grid rotated by the screen angle
+			} LatticeType;
+
+			/// Describes an additional V-bit that the job planner can assign
+			/// dots to.  The geometry follows the diagram above.
+			struct Tool
 			{
+				Tool()
+					: m_number(2)
+					, m_fullToolDepth(0)
+					, m_fullToolWidth(0)
+					, m_peckDepth(0)
+				{
+				}
+
+				int			m_number;					/// Tool number used in the tool change (T<n>M06) command
+				double	m_fullToolDepth;	/// Depth that can be cut by tool
+				double	m_fullToolWidth;	/// Width of tool at full tool depth
+				double	m_peckDepth;			/// Depth of each peck pass; 0 plunges in a single pass
+			};
+
+			/// The range of positions the machine can reach, in program units
+			/// (relative to the work origin).  An axis whose maximum is not
+			/// greater than its minimum isn't checked.
+			struct TravelLimits
+			{
+				TravelLimits()
+					: m_minX(0), m_maxX(0)
+					, m_minY(0), m_maxY(0)
+					, m_minZ(0), m_maxZ(0)
+				{
+				}
+
+				double	m_minX, m_maxX;
+				double	m_minY, m_maxY;
+				double	m_minZ, m_maxZ;
+			};
+
+			struct CNCParameters
+			{
+				CNCParameters()
+					: m_step(6)
+					, m_fullToolDepth(0.375)
+					, m_fullToolWidth(0.25)
+					, m_maxCutPercent(0.5)
+					, m_minDotGap(0.025)
+					, m_fastZ(0.1)
+					, m_toolNumber(1)
+					, m_peckDepth(0)
+					, m_minimizeTravel(false)
+					, m_depthLevels(0)
+					, m_gamma(1.0)
+					, m_modulation(BOX_MEAN)
+					, m_lattice(OFFSET_ROWS)
+					, m_screenAngle(45)
+					, m_outputWidth(0)
+					, m_outputHeight(0)
+					, m_dotPitch(0)
+					, m_maxThreads(0)
+				{
+				}
+
 				int			m_step;						/// The number of pixels to skip between dots
 				double	m_fullToolDepth;	/// Depth that can be cut by tool
 				double	m_fullToolWidth;	/// Width of tool at full tool depth
 				double	m_maxCutPercent;	/// Percentage used to compute max cut depth/diameter
 				double	m_minDotGap;			/// Minimum gap between dots
 				double	m_fastZ;					/// Z depth where tool can be moved quickly
-			} CNCParameters;
+				int			m_toolNumber;			/// Tool number of the primary tool (loaded by the preamble)
+				double	m_peckDepth;			/// Peck depth for the primary tool; 0 means no pecking
+				bool		m_minimizeTravel;	/// If true, dots are cut in serpentine order instead of raster order
+				std::vector<Tool>	m_tools;	/// Additional tools the job planner may use
+				int			m_depthLevels;		/// Number of distinct non-zero cut depths; 0 means unquantized
+				double	m_gamma;					/// Tone curve exponent applied to intensities before quantization
+				Modulation	m_modulation;	/// How cell intensities are turned into dot sizes
+				LatticeType	m_lattice;		/// The layout of the cells
+				double	m_screenAngle;		/// Rotation of the ROTATED lattice, in degrees
+				double	m_outputWidth;		/// Width of the output; if this or m_outputHeight is non-zero, the lattice is fitted to the output size and m_step is ignored
+				double	m_outputHeight;		/// Height of the output; 0 keeps the image's aspect ratio (as does giving both, by fitting the image within them)
+				double	m_dotPitch;				/// Distance between dots when fitting an output size; 0 means max dot size + m_minDotGap
+				TravelLimits	m_travelLimits;	/// Jobs that would move the tool outside these are rejected
+				int			m_maxThreads;			/// The most threads a job may use; 0 means one per core.  Doesn't change the output.
+			};
+
+			/// A single dot to be cut.  Dots are recorded in raster order.
+			struct Dot
+			{
+				double	m_x;			/// X coordinate of the cut, in output units
+				double	m_y;			/// Y coordinate of the cut, in output units
+				double	m_size;		/// Dot size in the range (0..1]
+				int			m_level;	/// Index of the dot size in the DepthMap
+				int			m_row;		/// Row of the dot in the halftone grid
+			};
+
+			/// What the generated g code does, worked out as it is generated
+			/// (the preamble and postamble aren't included).  Extents are NaN
+			/// if there are no moves.
+			struct MoveStatistics
+			{
+				MoveStatistics();
+
+				double	m_minX, m_maxX;			/// Extents of every position visited
+				double	m_minY, m_maxY;
+				double	m_minZ, m_maxZ;
+				int			m_rapidCount;				/// Number of G00 moves
+				int			m_feedCount;				/// Number of G01 moves
+				double	m_rapidDistance;		/// Total length of the G00 moves
+			};
 
 
 			/**
 			 * @brief Constructs a Halftoner object and performs all the output calculations.
 			 * @param src The source pixmap to be halftoned.
 			 * @param dest The destination image that will recieve the preview image
-			 * of the halftoned version of src.
+			 * of the halftoned version of src.  It may be 32-bit, or Indexed8
+			 * with a grey ramp color table (entry i being qRgb( i, i, i )).
 			 * @param scale The scale factor for the preview image.  Should be >= 1.
 			 * @param generateGCode If true, g code is generated (g code generation
 			 * can be time-consuming and may not be needed if all the user is doing
 			 * is trying out different parameters to see what they look like in the
 			 * preview).
 			 * @param params The parameters that control the generated g-code.
+			 * @param progress If not null, is kept up to date as the image is
+			 * processed, and is checked once per row of dots to see if the work
+			 * should be abandoned (see wasCancelled()).
 			 **/
-			Halftoner( const QPixmap& src, QImage& dest, int scale, bool generateGCode, const CNCParameters& params );
+			Halftoner( const QPixmap& src, QImage& dest, int scale, bool generateGCode, const CNCParameters& params, Progress* progress = 0 );
+
+			/**
+			 * @brief Same as above, but takes a QImage so it can be used
+			 * outside the GUI thread.  If dest is a null image, no preview is
+			 * drawn.
+			 **/
+			Halftoner( const QImage& src, QImage& dest, int scale, bool generateGCode, const CNCParameters& params, Progress* progress = 0 );
 
 
 			virtual ~Halftoner()
@@ -98,13 +233,57 @@ namespace HTCNC
 				return m_gCode; 
 			}
 
+			/// Returns true if the work was cancelled through the Progress
+			/// object, in which case there are no cuts, dots or g code and the
+			/// preview image is incomplete.
+			bool wasCancelled() const
+			{
+				return m_cancelled;
+			}
+
+			/// Returns the extents and moves of the g code.  Only filled in if
+			/// g code generation was requested.
+			const MoveStatistics& getMoveStatistics() const
+			{
+				return m_moveStatistics;
+			}
+
+			/// Returns a message for each axis on which the g code would move
+			/// the tool outside CNCParameters::m_travelLimits.  If there are any,
+			/// the job must not be run.
+			const QStringList& getTravelErrors() const
+			{
+				return m_travelErrors;
+			}
+
+			/// Returns the dots that were cut by the g code, in raster order.
+			/// Only filled in if g code generation was requested.
+			const std::vector<Dot>& getDots() const
+			{
+				return m_dots;
+			}
+
 		protected:
+			/// Does the work for the constructors.
+			void halftone( const QImage& src, QImage& dest, int scale, bool generateGCode, const CNCParameters& params, Progress* progress );
+
+			/// Throws away the partial results of a cancelled run.
+			void abandon();
+
 			/// The number of dots that will need to be cut.
 			int	m_cutCount;
 			/// The g code needed to cut the dots (does not include preamble or
 			//postamble--just the "G0X...Y... G1Z..." needed to move the cutter
 			//around, up and down).
 			QString	m_gCode;
+			/// The dots to be cut, in raster order.
+			std::vector<Dot>	m_dots;
+			/// What the g code does.
+			MoveStatistics	m_moveStatistics;
+			/// Where the g code goes outside the travel limits.
+			QStringList	m_travelErrors;
+			/// True if the work was cancelled.
+			bool	m_cancelled;
 	};
 
 }	// namespace HTCNC
@@ -0,0 +1,324 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "HTCNCImageLoader.h"
+#include "HTCNCGreyPlane.h"
+#include "HTCNCLattice.h"
+
+#include <QFile>
+#include <QImageReader>
+
+#include <algorithm>
+#include <vector>
+
+#include <ctype.h>
+
+namespace
+{
+	// With an output size, a reduced image must still have at least this
+	// many pixels per dot pitch.
+	const double	MIN_PIXELS_PER_DOT( 4.0 );
+
+	// Reads one number from a PGM header, skipping whitespace and comments
+	// before it and the single whitespace character after it.
+	bool readPGMNumber( QIODevice& in, int& value )
+	{
+		char	c;
+
+		for ( ;; )
+		{
+			if ( ! in.getChar( &c ) )
+				return false;
+			if ( c == '#' )
+			{
+				while ( c != '\n' )
+				{
+					if ( ! in.getChar( &c ) )
+						return false;
+				}
+			}
+			else if ( ! isspace( static_cast<unsigned char>( c ) ) )
+				break;
+		}
+
+		value = 0;
+		while ( isdigit( static_cast<unsigned char>( c ) ) )
+		{
+			value = value * 10 + ( c - '0' );
+			if ( value > 1000000 || ! in.getChar( &c ) )
+				return false;
+		}
+		return isspace( static_cast<unsigned char>( c ) ) != 0;
+	}
+
+
+	// Reducing by anything that doesn't divide both sides of the image
+	// would leave partial blocks at the edges, which stand for fewer pixels
+	// than the others and shift the bottom-up rows of the lattice.
+	bool dividesEvenly( const QSize& size, int reduction )
+	{
+		return size.width() % reduction == 0 && size.height() % reduction == 0;
+	}
+
+
+	// Maps each column of an image to the column of the reduced image it
+	// is averaged into.
+	std::vector<int> reducedColumns( int width, int reduction )
+	{
+		std::vector<int>	columns( width );
+
+		for ( int x = 0; x < width; ++x )
+			columns[x] = x / reduction;
+		return columns;
+	}
+
+
+	// Writes one row of a reduced image from the sums of its blocks.
+	// maxValue is the largest possible sample value.
+	void writeReducedRow( uchar* line, const std::vector<quint64>& sums, int width, int rows, int reduction, int maxValue )
+	{
+		for ( size_t ox = 0; ox < sums.size(); ++ox )
+		{
+			quint64	count( rows * std::min( reduction, width - int( ox ) * reduction ) );
+
+			// The mean, scaled to 0..255 and rounded.
+			line[ox] = uchar( ( 2 * sums[ox] * 255 + count * maxValue ) / ( 2 * count * maxValue ) );
+		}
+	}
+}
+
+
+namespace HTCNC
+{
+	ImageLoader::ImageLoader( const QString& filename )
+		: m_filename( filename )
+		, m_pgm( false )
+		, m_maxValue( 255 )
+		, m_dataOffset( 0 )
+	{
+		QFile	file( filename );
+
+		if ( file.open( QIODevice::ReadOnly ) && readPGMHeader( file ) )
+		{
+			m_pgm = true;
+			m_dataOffset = file.pos();
+		}
+		else
+			m_size = QImageReader( filename ).size();
+	}
+
+
+	int ImageLoader::getReduction( const Halftoner::CNCParameters& params ) const
+	{
+		if ( ! m_size.isValid() || m_size.isEmpty() )
+			return 1;
+
+		if ( params.m_outputWidth > 0 || params.m_outputHeight > 0 )
+		{
+			double	output_width, output_height;
+			double	pitch( Lattice::getPitch( params ) );
+
+			Lattice::getOutputSize( params, m_size.width(), m_size.height(), output_width, output_height );
+			if ( output_width <= 0 || output_height <= 0 || pitch <= 0 )
+				return 1;
+
+			double	pixels_per_dot( pitch * std::min( m_size.width() / output_width, m_size.height() / output_height ) );
+
+			for ( int reduction = 8; reduction > 1; reduction /= 2 )
+			{
+				if ( dividesEvenly( m_size, reduction ) && pixels_per_dot / reduction >= MIN_PIXELS_PER_DOT )
+					return reduction;
+			}
+			return 1;
+		}
+
+		// The hexagonal and rotated lattices put cells between pixels, and
+		// which pixel a cell snaps to depends on the resolution.
+		if ( params.m_lattice == Halftoner::HEXAGONAL || params.m_lattice == Halftoner::ROTATED )
+			return 1;
+
+		// The block a cell averages runs from step/2 before its center to
+		// step/2 after it, so as long as the reduced step is still even and
+		// the image is made of whole blocks, each reduced cell covers the
+		// same pixels the full sized one did (though their mean is taken from
+		// rounded block means).
+		for ( int reduction = 8; reduction > 1; reduction /= 2 )
+		{
+			if ( dividesEvenly( m_size, reduction ) && params.m_step % ( 2 * reduction ) == 0 )
+				return reduction;
+		}
+		return 1;
+	}
+
+
+	QImage ImageLoader::loadGrey( int reduction ) const
+	{
+		reduction = std::max( 1, reduction );
+
+		if ( m_pgm )
+		{
+			QFile	file( m_filename );
+
+			if ( ! file.open( QIODevice::ReadOnly ) || ! file.seek( m_dataOffset ) )
+				return QImage();
+			return readPGM( file, reduction );
+		}
+
+		QImageReader	reader( m_filename );
+		bool	scaled( false );
+
+		// Let the decoder do the reduction if it can (JPEG decoders skip most
+		// of their work at 1/2, 1/4 and 1/8 scale).  If the image doesn't
+		// divide evenly, the decoder would have to resample it, so it is
+		// reduced by averaging instead.
+		if ( reduction > 1 && m_size.isValid() && dividesEvenly( m_size, reduction ) &&
+				 reader.supportsOption( QImageIOHandler::ScaledSize ) )
+		{
+			reader.setScaledSize( m_size / reduction );
+			scaled = true;
+		}
+
+		return toGrey( reader.read(), scaled ? 1 : reduction );
+	}
+
+
+	QImage ImageLoader::loadForJob( Halftoner::CNCParameters& params, int* reduction ) const
+	{
+		int			r( getReduction( params ) );
+		QImage	img( loadGrey( r ) );
+
+		if ( ! img.isNull() )
+			adjustParams( params, r );
+		if ( reduction )
+			*reduction = r;
+		return img;
+	}
+
+
+	void ImageLoader::adjustParams( Halftoner::CNCParameters& params, int reduction )
+	{
+		// An output size doesn't depend on the resolution, but a step does.
+		if ( params.m_outputWidth <= 0 && params.m_outputHeight <= 0 )
+			params.m_step /= reduction;
+	}
+
+
+	QImage ImageLoader::toGrey( const QImage& src, int reduction )
+	{
+		if ( src.isNull() )
+			return QImage();
+
+		QVector<QRgb>	grey( greyTable() );
+
+		reduction = std::max( 1, reduction );
+		if ( reduction == 1 && src.format() == QImage::Format_Indexed8 && src.colorTable() == grey )
+			return src;
+
+		const int	width( src.width() ), height( src.height() );
+		QImage	dest( ( width + reduction - 1 ) / reduction, ( height + reduction - 1 ) / reduction, QImage::Format_Indexed8 );
+
+		dest.setColorTable( grey );
+
+		std::vector<int>			columns( reducedColumns( width, reduction ) );
+		std::vector<quint64>	sums( dest.width() );
+		std::vector<uchar>		row( width );
+		GreyPlane::RowConverter	converter( src );
+
+		for ( int oy = 0; oy < dest.height(); ++oy )
+		{
+			int	rows( std::min( reduction, height - oy * reduction ) );
+
+			std::fill( sums.begin(), sums.end(), 0 );
+			for ( int y = oy * reduction; y < oy * reduction + rows; ++y )
+			{
+				converter.convert( y, &row[0] );
+				for ( int x = 0; x < width; ++x )
+					sums[columns[x]] += row[x];
+			}
+			writeReducedRow( dest.scanLine( oy ), sums, width, rows, reduction, 255 );
+		}
+
+		return dest;
+	}
+
+
+	QVector<QRgb> ImageLoader::greyTable()
+	{
+		QVector<QRgb>	table( 256 );
+
+		for ( int i = 0; i < 256; ++i )
+			table[i] = qRgb( i, i, i );
+		return table;
+	}
+
+
+	bool ImageLoader::readPGMHeader( QIODevice& in )
+	{
+		int	width, height, max_value;
+
+		if ( in.read( 2 ) != "P5" ||
+				 ! readPGMNumber( in, width ) ||
+				 ! readPGMNumber( in, height ) ||
+				 ! readPGMNumber( in, max_value ) ||
+				 width <= 0 || height <= 0 || max_value <= 0 || max_value > 65535 )
+			return false;
+
+		m_size = QSize( width, height );
+		m_maxValue = max_value;
+		return true;
+	}
+
+
+	QImage ImageLoader::readPGM( QIODevice& in, int reduction ) const
+	{
+		const int	width( m_size.width() ), height( m_size.height() );
+		// Samples above 255 take two bytes, most significant first.
+		const int	sample_size( m_maxValue > 255 ? 2 : 1 );
+		QImage	dest( ( width + reduction - 1 ) / reduction, ( height + reduction - 1 ) / reduction, QImage::Format_Indexed8 );
+
+		dest.setColorTable( greyTable() );
+
+		std::vector<int>			columns( reducedColumns( width, reduction ) );
+		std::vector<quint64>	sums( dest.width() );
+		QByteArray	row( width * sample_size, 0 );
+
+		for ( int oy = 0; oy < dest.height(); ++oy )
+		{
+			int	rows( std::min( reduction, height - oy * reduction ) );
+
+			std::fill( sums.begin(), sums.end(), 0 );
+			for ( int i = 0; i < rows; ++i )
+			{
+				if ( in.read( row.data(), row.size() ) != row.size() )
+					return QImage();
+
+				const uchar*	samples( reinterpret_cast<const uchar*>( row.constData() ) );
+
+				for ( int x = 0; x < width; ++x )
+				{
+					int	value( sample_size == 2 ? ( samples[2*x] << 8 ) | samples[2*x + 1] : samples[x] );
+
+					sums[columns[x]] += std::min( value, m_maxValue );
+				}
+			}
+			writeReducedRow( dest.scanLine( oy ), sums, width, rows, reduction, m_maxValue );
+		}
+
+		return dest;
+	}
+}
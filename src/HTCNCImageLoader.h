@@ -0,0 +1,131 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#ifndef HTCNCIMAGELOADER_H
+#define HTCNCIMAGELOADER_H
+
+#include "HTCNCHalftoner.h"
+
+#include <QImage>
+#include <QSize>
+#include <QString>
+#include <QVector>
+
+// Forward decls
+class QIODevice;
+
+namespace HTCNC
+{
+
+	/*@brief Loads source images as 8 bit grey, no larger than a job needs.
+	 *
+	 * Only the intensity of the source is ever used, and with a large pixel
+	 * step only a fraction of its resolution, so there is no point in
+	 * decoding a big photo to full size 32 bit color.  The loader works out
+	 * how much smaller the image can be decoded without changing which
+	 * pixels each cell averages, and then:
+	 * - JPEGs are decoded at 1/2, 1/4 or 1/8 scale by the decoder itself.
+	 * - Binary PGMs, including 16 bit ones, are read a row at a time
+	 *   straight into the reduced grey image.
+	 * - Anything else is decoded by Qt and reduced while it is converted.
+	 *
+	 * The result is always an Indexed8 image whose color table is a grey
+	 * ramp, so each pixel's index is its intensity.
+	 *
+	 * A reduced image's pixels are rounded to 8 bits, so the intensities
+	 * the cells average from them can differ slightly from a full size
+	 * decode: by at most one grey level when the loader averages the blocks
+	 * itself.  A JPEG decoder filters rather than averages as it scales,
+	 * which usually also stays within one level but can reach a few in fine,
+	 * colorful detail.  A job loaded this way can therefore have some dots
+	 * cut a depth level away from the same job loaded at full size.
+	 **/
+	class ImageLoader
+	{
+		public:
+			/// Reads the size of the image from the file's header.
+			ImageLoader( const QString& filename );
+
+			/// Returns the full size of the image, or an invalid size if the
+			/// file can't be read.
+			QSize getSize() const
+			{
+				return m_size;
+			}
+
+			/**
+			 * @brief Returns how many times smaller than full size the image can
+			 * be loaded for a job: 1, 2, 4 or 8.
+			 * The reduction must divide both the width and the height of the
+			 * image.  With a pixel step, the lattice must also be a square or
+			 * offset one and the step must stay even at the reduced size, so each
+			 * cell still covers the same block of the source (see above for how
+			 * closely its intensity matches).  With an output size (which doesn't
+			 * depend on the resolution at all), a dot must still span at least a
+			 * few pixels; its edges then fall within the reduced pixels, so a
+			 * cell on a sharp edge in the image can differ by more.
+			 **/
+			int getReduction( const Halftoner::CNCParameters& params ) const;
+
+			/**
+			 * @brief Loads the image as 8 bit grey.
+			 * @param reduction Each pixel of the result is the mean of a
+			 * reduction x reduction block of the source; partial blocks at the
+			 * right and bottom edges are averaged over the pixels they have.
+			 * @return The image, or a null image if it can't be read.
+			 **/
+			QImage loadGrey( int reduction = 1 ) const;
+
+			/**
+			 * @brief Loads the image as small as getReduction() allows.
+			 * @param params Adjusted to match the reduced image.
+			 * @param reduction If not null, receives the reduction used.
+			 **/
+			QImage loadForJob( Halftoner::CNCParameters& params, int* reduction = 0 ) const;
+
+			/// Adjusts params to match an image loaded reduction times smaller
+			/// than full size (as loadForJob() does).
+			static void adjustParams( Halftoner::CNCParameters& params, int reduction );
+
+			/// Converts an image to 8 bit grey, averaging reduction x reduction
+			/// blocks of it.
+			static QImage toGrey( const QImage& src, int reduction = 1 );
+
+			/// Returns a grey ramp color table: entry i is qRgb( i, i, i ).
+			static QVector<QRgb> greyTable();
+
+		private:
+			/// Parses the header of a binary PGM, leaving in at the start of
+			/// the pixels.  Returns false if the file isn't one.
+			bool readPGMHeader( QIODevice& in );
+
+			/// Reads the pixels of a binary PGM whose header has been read.
+			QImage readPGM( QIODevice& in, int reduction ) const;
+
+			QString	m_filename;
+			QSize		m_size;
+			bool		m_pgm;				/// True if the file is a binary PGM
+			int			m_maxValue;		/// The PGM's maximum sample value
+			qint64	m_dataOffset;	/// Where the PGM's pixels start
+	};
+
+}	// namespace HTCNC
+
+
+#endif
@@ -0,0 +1,70 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "HTCNCImageView.h"
+
+#include <QPainter>
+#include <QPaintEvent>
+
+
+namespace HTCNCUI
+{
+
+
+ImageView::ImageView(QWidget *parent)
+	: QWidget(parent)
+{
+}
+
+
+void ImageView::setImage( const QImage& image )
+{
+	m_image = image;
+	updateGeometry();
+	adjustSize();
+	update();
+}
+
+
+QSize ImageView::sizeHint() const
+{
+	return m_image.size();
+}
+
+
+QSize ImageView::minimumSizeHint() const
+{
+	return m_image.size();
+}
+
+
+void ImageView::paintEvent( QPaintEvent* event )
+{
+	QRect	area( event->rect() & m_image.rect() );
+
+	if ( area.isEmpty() )
+		return;
+
+	// Only the exposed rectangle is converted for display.
+	QPainter	painter( this );
+
+	painter.drawImage( area.topLeft(), m_image, area );
+}
+
+
+}	// namespace HTCNCUI
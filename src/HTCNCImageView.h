@@ -0,0 +1,67 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#ifndef HTCNCIMAGEVIEW_H
+#define HTCNCIMAGEVIEW_H
+
+#include <QImage>
+#include <QWidget>
+
+
+namespace HTCNCUI
+{
+
+
+/**@brief Shows an image at its actual size, for use in a scroll area.
+ * Unlike a QLabel, which needs a QPixmap, the image is kept as it is (the
+ * preview is 8 bit grey) and only the part of it that needs repainting is
+ * drawn, so there is no full-size conversion each time it changes.
+ */
+class ImageView : public QWidget
+{
+     Q_OBJECT
+
+public:
+	/// Standard constructor
+	ImageView(QWidget *parent = 0);
+
+	/// Shows an image.  QImage is implicitly shared, so this doesn't copy it.
+	void setImage( const QImage& image );
+
+	const QImage& getImage() const
+	{
+		return m_image;
+	}
+
+	/// The size of the image.
+	virtual QSize sizeHint() const;
+	virtual QSize minimumSizeHint() const;
+
+protected:
+	/// Draws the exposed part of the image.
+	virtual void paintEvent( QPaintEvent* event );
+
+private:
+	QImage	m_image;
+};
+
+
+}	// namespace HTCNCUI
+
+#endif
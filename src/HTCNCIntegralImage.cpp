@@ -0,0 +1,102 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "HTCNCIntegralImage.h"
+#include "HTCNCGreyPlane.h"
+
+#include <algorithm>
+
+#include <math.h>
+
+namespace HTCNC
+{
+	IntegralImage::IntegralImage( const GreyPlane& src )
+		: m_width( src.getWidth() )
+		, m_height( src.getHeight() )
+	{
+		if ( 255.0 * m_width * m_height <= 4294967295.0 )
+			build( src, m_sums32 );
+		else
+			build( src, m_sums64 );
+	}
+
+
+	double IntegralImage::getMean( double left, double top, double right, double bottom ) const
+	{
+		left = std::max( 0.0, left );
+		top = std::max( 0.0, top );
+		right = std::min( double( m_width ), right );
+		bottom = std::min( double( m_height ), bottom );
+
+		double	area( ( right - left ) * ( bottom - top ) );
+
+		if ( area <= 0 )
+			return 0;
+
+		double	sum( m_sums64.empty() ? getSum( m_sums32, left, top, right, bottom ) :
+																	getSum( m_sums64, left, top, right, bottom ) );
+
+		return std::min( 255.0, std::max( 0.0, sum / area ) );
+	}
+
+
+	template <typename Sum>
+	void IntegralImage::build( const GreyPlane& src, std::vector<Sum>& sums )
+	{
+		int		stride( m_width + 1 );
+
+		sums.assign( stride * ( m_height + 1 ), 0 );
+		for ( int y = 0; y < m_height; ++y )
+		{
+			const unsigned char*	line( src.getRow( y ) );
+			const Sum*	above( &sums[y * stride] );
+			Sum*	row( &sums[( y + 1 ) * stride] );
+			Sum		row_sum( 0 );
+
+			for ( int x = 0; x < m_width; ++x )
+			{
+				row_sum += line[x];
+				row[x + 1] = above[x + 1] + row_sum;
+			}
+		}
+	}
+
+
+	template <typename Sum>
+	double IntegralImage::getSum( const std::vector<Sum>& sums, double left, double top, double right, double bottom ) const
+	{
+		return integral( sums, right, bottom ) - integral( sums, left, bottom ) -
+					 integral( sums, right, top ) + integral( sums, left, top );
+	}
+
+
+	template <typename Sum>
+	double IntegralImage::integral( const std::vector<Sum>& sums, double x, double y ) const
+	{
+		// The integral is bilinear between the table entries.
+		int		x0( std::min( m_width - 1, int( floor( x ) ) ) );
+		int		y0( std::min( m_height - 1, int( floor( y ) ) ) );
+		double	fx( x - x0 ), fy( y - y0 );
+		int		stride( m_width + 1 );
+		const Sum*	row0( &sums[y0 * stride + x0] );
+		const Sum*	row1( row0 + stride );
+
+		return ( double( row0[0] ) * ( 1 - fx ) + double( row0[1] ) * fx ) * ( 1 - fy ) +
+					 ( double( row1[0] ) * ( 1 - fx ) + double( row1[1] ) * fx ) * fy;
+	}
+}
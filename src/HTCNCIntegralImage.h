@@ -0,0 +1,82 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#ifndef HTCNCINTEGRALIMAGE_H
+#define HTCNCINTEGRALIMAGE_H
+
+#include <QtGlobal>
+
+#include <vector>
+
+namespace HTCNC
+{
+	class GreyPlane;
+
+	/*@brief A summed area table of an image's greyscale intensities.
+	 *
+	 * Entry (x, y) holds the sum of the intensities of every pixel above and
+	 * to the left of pixel (x, y).  Treating each pixel as a constant over its
+	 * unit square, the integral of the image from the origin to any point is
+	 * the bilinear interpolation of the table, so the mean intensity of any
+	 * rectangle, including ones whose edges cut through pixels, takes four
+	 * lookups no matter how large the rectangle is.
+	 **/
+	class IntegralImage
+	{
+		public:
+			/// Builds the table for an image.
+			IntegralImage( const GreyPlane& src );
+
+			/**
+			 * @brief Returns the mean intensity of a rectangle, in the range
+			 * [0..255].  Partly covered pixels count in proportion to the area
+			 * covered.
+			 * @param left, top, right, bottom The rectangle in pixels (0,0 being
+			 * the top left corner of the image); it is clipped to the image.
+			 **/
+			double getMean( double left, double top, double right, double bottom ) const;
+
+		private:
+			/// Fills in a table of (m_width+1) x (m_height+1) sums.
+			template <typename Sum>
+			void build( const GreyPlane& src, std::vector<Sum>& sums );
+
+			/// Returns the sum of the pixels within a rectangle, which must be
+			/// within the image.
+			template <typename Sum>
+			double getSum( const std::vector<Sum>& sums, double left, double top, double right, double bottom ) const;
+
+			/// Returns the integral of the image from the origin to (x, y),
+			/// which must be within the image.
+			template <typename Sum>
+			double integral( const std::vector<Sum>& sums, double x, double y ) const;
+
+			int	m_width;
+			int	m_height;
+			/// The sums are kept as exact integers.  32 bits hold them for
+			/// images of up to 16 million pixels, and only larger images use
+			/// the 64 bit table.  Just one of the two is filled in.
+			std::vector<quint32>	m_sums32;
+			std::vector<quint64>	m_sums64;
+	};
+
+}	// namespace HTCNC
+
+
+#endif
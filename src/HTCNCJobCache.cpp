@@ -0,0 +1,135 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "HTCNCJobCache.h"
+#include "HTCNCHalftoner.h"
+#include "HTCNCProfile.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDesktopServices>
+#include <QDir>
+#include <QFile>
+#include <QSettings>
+
+namespace HTCNC
+{
+	JobCache::JobCache( const QString& directory )
+		: m_directory( directory.isEmpty() ? defaultDirectory() : directory )
+	{
+	}
+
+
+	QString JobCache::defaultDirectory()
+	{
+		return QDesktopServices::storageLocation( QDesktopServices::CacheLocation ) + "/jobs";
+	}
+
+
+	QByteArray JobCache::hashFile( const QString& filename )
+	{
+		QFile	file( filename );
+
+		if ( ! file.open( QIODevice::ReadOnly ) )
+			return QByteArray();
+
+		QCryptographicHash	hash( QCryptographicHash::Sha1 );
+
+		while ( ! file.atEnd() )
+			hash.addData( file.read( 1 << 16 ) );
+		return hash.result().toHex();
+	}
+
+
+	QByteArray JobCache::makeKey( const QByteArray& sourceHash, const Profile& profile )
+	{
+		return QCryptographicHash::hash( QByteArray::number( Halftoner::GENERATOR_VERSION ) + ":" +
+																		 sourceHash + ":" + profile.hash(),
+																		 QCryptographicHash::Sha1 ).toHex();
+	}
+
+
+	bool JobCache::lookup( const QByteArray& key, QByteArray& gCode, int& cutCount ) const
+	{
+		if ( ! QFile::exists( manifestFilename( key ) ) )
+			return false;
+
+		QSettings	manifest( manifestFilename( key ), QSettings::IniFormat );
+		QByteArray	output_hash( manifest.value( "output_hash" ).toByteArray() );
+		QFile	object( objectFilename( output_hash ) );
+
+		if ( output_hash.isEmpty() || ! object.open( QIODevice::ReadOnly ) )
+			return false;
+
+		gCode = object.readAll();
+
+		// Don't trust an object that has been damaged since it was written.
+		if ( QCryptographicHash::hash( gCode, QCryptographicHash::Sha1 ).toHex() != output_hash )
+			return false;
+
+		cutCount = manifest.value( "cut_count" ).toInt();
+		return true;
+	}
+
+
+	bool JobCache::store( const QByteArray& key,
+												const QByteArray& sourceHash,
+												const QString& profileName,
+												const Profile& profile,
+												const QByteArray& gCode,
+												int cutCount ) const
+	{
+		QByteArray	output_hash( QCryptographicHash::hash( gCode, QCryptographicHash::Sha1 ).toHex() );
+
+		if ( ! QDir().mkpath( m_directory + "/objects" ) || ! QDir().mkpath( m_directory + "/manifests" ) )
+			return false;
+
+		if ( ! QFile::exists( objectFilename( output_hash ) ) )
+		{
+			QFile	object( objectFilename( output_hash ) );
+
+			if ( ! object.open( QIODevice::WriteOnly ) || object.write( gCode ) != gCode.size() )
+				return false;
+		}
+
+		QSettings	manifest( manifestFilename( key ), QSettings::IniFormat );
+
+		manifest.setValue( "source_hash", sourceHash );
+		manifest.setValue( "profile_name", profileName );
+		manifest.setValue( "profile_hash", profile.hash() );
+		manifest.setValue( "generator_version", Halftoner::GENERATOR_VERSION );
+		manifest.setValue( "output_hash", output_hash );
+		manifest.setValue( "cut_count", cutCount );
+		manifest.setValue( "created", QDateTime::currentDateTime() );
+		manifest.sync();
+		return manifest.status() == QSettings::NoError;
+	}
+
+
+	QString JobCache::manifestFilename( const QByteArray& key ) const
+	{
+		return m_directory + "/manifests/" + QString::fromLatin1( key ) + ".ini";
+	}
+
+
+	QString JobCache::objectFilename( const QByteArray& outputHash ) const
+	{
+		return m_directory + "/objects/" + QString::fromLatin1( outputHash ) + ".ngc";
+	}
+}
+
@@ -0,0 +1,87 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#ifndef HTCNCJOBCACHE_H
+#define HTCNCJOBCACHE_H
+
+#include <QByteArray>
+#include <QString>
+
+namespace HTCNC
+{
+	struct Profile;
+
+	/*@brief A content-addressed cache of previously generated g code.
+	 *
+	 * A job is identified by a key made from the hash of the source image
+	 * file, the hash of the profile it was run with and the version of the
+	 * generator (Halftoner::GENERATOR_VERSION).  For each job the
+	 * cache keeps a manifest (manifests/<key>.ini) recording the source hash,
+	 * profile name and hash, cut count and the hash of the g code, which is
+	 * itself stored as objects/<output hash>.ngc.  Identical output from
+	 * different jobs is only stored once.
+	 **/
+	class JobCache
+	{
+		public:
+			/// Uses the given directory, or the default one if it is empty.
+			JobCache( const QString& directory = QString() );
+
+			/// Returns the default location of the cache.
+			static QString defaultDirectory();
+
+			/// Returns the hash (as hex) of a file's contents, or an empty
+			/// array if the file can't be read.
+			static QByteArray hashFile( const QString& filename );
+
+			/// Returns the key of a job.
+			static QByteArray makeKey( const QByteArray& sourceHash, const Profile& profile );
+
+			/**
+			 * @brief Looks up a job.
+			 * @param key The job's key.
+			 * @param gCode Receives the cached g code.
+			 * @param cutCount Receives the cached cut count.
+			 * @return true if the job was found and its output is intact.
+			 **/
+			bool lookup( const QByteArray& key, QByteArray& gCode, int& cutCount ) const;
+
+			/**
+			 * @brief Adds a job to the cache.
+			 * @return false if the cache could not be written.
+			 **/
+			bool store( const QByteArray& key,
+									const QByteArray& sourceHash,
+									const QString& profileName,
+									const Profile& profile,
+									const QByteArray& gCode,
+									int cutCount ) const;
+
+		private:
+			QString manifestFilename( const QByteArray& key ) const;
+			QString objectFilename( const QByteArray& outputHash ) const;
+
+			QString	m_directory;
+	};
+
+}	// namespace HTCNC
+
+
+#endif
+
@@ -0,0 +1,341 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "HTCNCJobPlanner.h"
+#include "HTCNCDepthMap.h"
+
+#include <QObject>
+
+#include <algorithm>
+#include <limits>
+
+#include <math.h>
+
+namespace
+{
+	// Coordinates that haven't been set (or that a move doesn't change).
+	const double	NOT_SET( std::numeric_limits<double>::quiet_NaN() );
+
+	bool isSet( double value )
+	{
+		// NaN is the only value that isn't equal to itself.
+		return value == value;
+	}
+}
+
+
+namespace HTCNC
+{
+	JobPlanner::JobPlanner( const Halftoner::CNCParameters& params )
+		: m_params( params )
+		, m_maxDotSize( params.m_fullToolWidth * params.m_maxCutPercent )
+		, m_liftCode( "G00Z" + QString::number( params.m_fastZ ) + "\n" )
+	{
+		PlannedTool	primary;
+
+		primary.m_number = params.m_toolNumber;
+		primary.m_maxDiameter = m_maxDotSize;
+		primary.m_depthPerSize = params.m_fullToolDepth * params.m_maxCutPercent;
+		primary.m_peckDepth = params.m_peckDepth;
+		m_tools.push_back( primary );
+
+		for ( size_t i = 0; i < params.m_tools.size(); ++i )
+		{
+			const Halftoner::Tool&	t( params.m_tools[i] );
+			PlannedTool	pt;
+
+			pt.m_number = t.m_number;
+			pt.m_peckDepth = t.m_peckDepth;
+			if ( t.m_fullToolWidth > 0 && t.m_fullToolDepth > 0 )
+			{
+				// The same percentage limit applies to every tool.  For a V-bit,
+				// depth is proportional to the diameter of the cut.
+				pt.m_maxDiameter = t.m_fullToolWidth * params.m_maxCutPercent;
+				pt.m_depthPerSize = t.m_fullToolDepth * m_maxDotSize / t.m_fullToolWidth;
+			}
+			else
+			{
+				// Bogus geometry; never assign anything to this tool.
+				pt.m_maxDiameter = -1;
+				pt.m_depthPerSize = 0;
+			}
+			m_tools.push_back( pt );
+		}
+
+		DepthMap	depth_map( params.m_depthLevels, params.m_gamma );
+
+		for ( size_t t = 0; t < m_tools.size(); ++t )
+		{
+			PlannedTool&	tool( m_tools[t] );
+
+			tool.m_plunges.resize( depth_map.getLevelCount() );
+			for ( int l = 0; l < depth_map.getLevelCount(); ++l )
+			{
+				tool.m_plunges[l] = makePlunge( tool, tool.m_depthPerSize * depth_map.getDotSize( l ) );
+			}
+		}
+	}
+
+
+	int JobPlanner::assignTool( double dotSize ) const
+	{
+		double	diameter( m_maxDotSize * dotSize );
+		int			best(0);
+
+		// The primary tool can cut every dot, so it is the fallback.
+		for ( size_t i = 1; i < m_tools.size(); ++i )
+		{
+			if ( m_tools[i].m_maxDiameter >= diameter &&
+					 m_tools[i].m_maxDiameter < m_tools[best].m_maxDiameter )
+			{
+				best = static_cast<int>( i );
+			}
+		}
+		return best;
+	}
+
+
+	QString JobPlanner::generate( const std::vector<Halftoner::Dot>& dots,
+																Halftoner::MoveStatistics* stats,
+																const ProgressStage& progress ) const
+	{
+		QString	gCode;
+		std::vector< std::vector<size_t> >	buckets( m_tools.size() );
+		// The number of dots in the buckets already done.
+		size_t	done( 0 );
+		double	lastY( NOT_SET );
+		// The index of the tool that is loaded.
+		size_t	loaded( 0 );
+		Halftoner::MoveStatistics	unused_stats;
+		Tracker	tracker( stats ? *stats : unused_stats );
+
+		if ( stats )
+			*stats = Halftoner::MoveStatistics();
+
+		for ( size_t i = 0; i < dots.size(); ++i )
+		{
+			buckets[ assignTool( dots[i].m_size ) ].push_back( i );
+		}
+
+		for ( size_t b = 0; b < buckets.size(); ++b )
+		{
+			const std::vector<size_t>&	bucket( buckets[b] );
+			const PlannedTool&	tool( m_tools[b] );
+
+			if ( bucket.empty() )
+				continue;
+
+			if ( b != 0 )
+			{
+				// Lift tool to safe 'fast z' depth and swap tools.  Then pick up
+				// the new tool's length offset and restart the spindle, which
+				// the change stops (S is modal, so the speed given at the start
+				// of the file still applies).
+				gCode += m_liftCode;
+				tracker.move( true, NOT_SET, NOT_SET, m_params.m_fastZ );
+				gCode += "T" + QString::number( tool.m_number ) + "M06\n";
+				gCode += "G43H" + QString::number( tool.m_number ) + "\n";
+				gCode += "M03\n";
+				loaded = b;
+
+				// The change may have moved the tool, so don't rely on the modal Y.
+				lastY = NOT_SET;
+			}
+
+			if ( ! m_params.m_minimizeTravel )
+			{
+				for ( size_t i = 0; i < bucket.size(); ++i )
+				{
+					// Check in at the start of each row.
+					if ( ( i == 0 || dots[bucket[i]].m_row != dots[bucket[i-1]].m_row ) &&
+							 ! progress.update( int( done + i ), int( dots.size() ) ) )
+						return QString();
+
+					emitDot( gCode, dots[bucket[i]], tool, lastY, tracker );
+				}
+				done += bucket.size();
+				continue;
+			}
+
+			// Serpentine order: the dots are in raster order, so every other
+			// row is simply walked backwards.
+			bool	reverse(false);
+
+			for ( size_t start = 0; start < bucket.size(); )
+			{
+				size_t	end( start );
+
+				if ( ! progress.update( int( done + start ), int( dots.size() ) ) )
+					return QString();
+
+				while ( end < bucket.size() && dots[bucket[end]].m_row == dots[bucket[start]].m_row )
+					++end;
+
+				if ( reverse )
+				{
+					for ( size_t i = end; i > start; --i )
+						emitDot( gCode, dots[bucket[i-1]], tool, lastY, tracker );
+				}
+				else
+				{
+					for ( size_t i = start; i < end; ++i )
+						emitDot( gCode, dots[bucket[i]], tool, lastY, tracker );
+				}
+				reverse = ! reverse;
+				start = end;
+			}
+			done += bucket.size();
+		}
+
+		// Finally, make sure the tool is parked at a safe depth.
+		gCode += "G00Z" + QString::number( m_params.m_fastZ ); // Lift tool to safe 'fast z' depth.
+		gCode += "\n";
+		tracker.move( true, NOT_SET, NOT_SET, m_params.m_fastZ );
+
+		// Leave the primary tool loaded, as the next program expects.
+		if ( loaded != 0 )
+		{
+			gCode += "T" + QString::number( m_tools[0].m_number ) + "M06\n";
+			gCode += "G43H" + QString::number( m_tools[0].m_number ) + "\n";
+		}
+
+		return gCode;
+	}
+
+
+	void JobPlanner::emitDot( QString& gCode, const Halftoner::Dot& dot, const PlannedTool& tool, double& lastY, Tracker& tracker ) const
+	{
+		// Lift tool to safe 'fast z' depth.
+		gCode += m_liftCode;
+		tracker.move( true, NOT_SET, NOT_SET, m_params.m_fastZ );
+
+		// Move tool to cut location.  Y is modal, so it is only written when
+		// it changes.
+		gCode += "G00X" + QString::number( dot.m_x );
+		if ( dot.m_y != lastY )
+		{
+			gCode += "Y" + QString::number( dot.m_y );
+			lastY = dot.m_y;
+		}
+		gCode += "\n";
+		tracker.move( true, dot.m_x, dot.m_y, NOT_SET );
+
+		// Move tool to cut depth.
+		const Plunge&	plunge( tool.m_plunges[dot.m_level] );
+
+		gCode += plunge.m_code;
+		for ( size_t i = 0; i < plunge.m_pecks.size(); ++i )
+		{
+			tracker.move( false, NOT_SET, NOT_SET, -plunge.m_pecks[i] );
+			tracker.move( true, NOT_SET, NOT_SET, 0 );
+		}
+		tracker.move( false, NOT_SET, NOT_SET, -plunge.m_depth );
+	}
+
+
+	JobPlanner::Plunge JobPlanner::makePlunge( const PlannedTool& tool, double depth )
+	{
+		Plunge	plunge;
+
+		if ( tool.m_peckDepth > 0 )
+		{
+			for ( double z = tool.m_peckDepth; z < depth - 1e-9; z += tool.m_peckDepth )
+			{
+				plunge.m_code += "G01Z" + QString::number( -z ) + "\n";
+				plunge.m_code += "G00Z0\n";
+				plunge.m_pecks.push_back( z );
+			}
+		}
+		plunge.m_code += "G01Z" + QString::number( - depth ) + "\n";
+		plunge.m_depth = depth;
+		return plunge;
+	}
+
+
+	QStringList JobPlanner::checkTravel( const Halftoner::MoveStatistics& stats, const Halftoner::TravelLimits& limits )
+	{
+		const char*	names[3] = { "X", "Y", "Z" };
+		double	lows[3] = { stats.m_minX, stats.m_minY, stats.m_minZ };
+		double	highs[3] = { stats.m_maxX, stats.m_maxY, stats.m_maxZ };
+		double	min_limits[3] = { limits.m_minX, limits.m_minY, limits.m_minZ };
+		double	max_limits[3] = { limits.m_maxX, limits.m_maxY, limits.m_maxZ };
+		QStringList	errors;
+
+		for ( int i = 0; i < 3; ++i )
+		{
+			// NaN extents (no moves) never compare outside.
+			if ( max_limits[i] > min_limits[i] && ( lows[i] < min_limits[i] || highs[i] > max_limits[i] ) )
+			{
+				errors << QObject::tr("%1 moves from %2 to %3, outside the machine's travel of %4 to %5.")
+										.arg( names[i] ).arg( lows[i] ).arg( highs[i] ).arg( min_limits[i] ).arg( max_limits[i] );
+			}
+		}
+		return errors;
+	}
+
+
+	JobPlanner::Tracker::Tracker( Halftoner::MoveStatistics& stats )
+		: m_stats( stats )
+		, m_x( NOT_SET )
+		, m_y( NOT_SET )
+		, m_z( NOT_SET )
+	{
+	}
+
+
+	void JobPlanner::Tracker::move( bool rapid, double x, double y, double z )
+	{
+		double	nx( isSet( x ) ? x : m_x );
+		double	ny( isSet( y ) ? y : m_y );
+		double	nz( isSet( z ) ? z : m_z );
+
+		// Distances are only known once the whole position is.
+		if ( rapid && isSet( m_x ) && isSet( m_y ) && isSet( m_z ) )
+		{
+			double	dx( nx - m_x ), dy( ny - m_y ), dz( nz - m_z );
+
+			m_stats.m_rapidDistance += sqrt( dx * dx + dy * dy + dz * dz );
+		}
+
+		if ( rapid )
+			++m_stats.m_rapidCount;
+		else
+			++m_stats.m_feedCount;
+
+		if ( isSet( nx ) )
+		{
+			m_stats.m_minX = isSet( m_stats.m_minX ) ? std::min( m_stats.m_minX, nx ) : nx;
+			m_stats.m_maxX = isSet( m_stats.m_maxX ) ? std::max( m_stats.m_maxX, nx ) : nx;
+		}
+		if ( isSet( ny ) )
+		{
+			m_stats.m_minY = isSet( m_stats.m_minY ) ? std::min( m_stats.m_minY, ny ) : ny;
+			m_stats.m_maxY = isSet( m_stats.m_maxY ) ? std::max( m_stats.m_maxY, ny ) : ny;
+		}
+		if ( isSet( nz ) )
+		{
+			m_stats.m_minZ = isSet( m_stats.m_minZ ) ? std::min( m_stats.m_minZ, nz ) : nz;
+			m_stats.m_maxZ = isSet( m_stats.m_maxZ ) ? std::max( m_stats.m_maxZ, nz ) : nz;
+		}
+
+		m_x = nx;
+		m_y = ny;
+		m_z = nz;
+	}
+}
+
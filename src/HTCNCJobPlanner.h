@@ -0,0 +1,140 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#ifndef HTCNCJOBPLANNER_H
+#define HTCNCJOBPLANNER_H
+
+#include "HTCNCHalftoner.h"
+#include "HTCNCProgress.h"
+
+#include <QString>
+#include <QStringList>
+
+#include <vector>
+
+namespace HTCNC
+{
+
+	/*@brief Turns the dots computed by a Halftoner into g code.
+	 *
+	 * Each dot is assigned to the finest tool that can cut it (the tool with
+	 * the smallest maximum cut diameter that is still at least as large as
+	 * the dot), so shallow dots can be cut with a finer bit.  The dots for
+	 * each tool are cut together, with a tool change (T<n>M06, then G43H<n>
+	 * and M03 to apply its length offset and restart the spindle) between
+	 * groups.  The primary tool (the one described by the CNCParameters
+	 * width/depth) is assumed to be loaded by the preamble and is always
+	 * cut first; if another tool was used, the program changes back to it
+	 * (T<n>M06 and G43H<n>) after the last cut.  Deep dots can be cut in
+	 * several peck passes.
+	 *
+	 * Since dot sizes come from a DepthMap, the plunge moves for every tool
+	 * and level are formatted once up front rather than once per dot.
+	 *
+	 * The extents and moves of the g code are tallied as it is generated,
+	 * so a job can be checked against the machine's travel limits without
+	 * reading the g code back.
+	 **/
+	class JobPlanner
+	{
+		public:
+			/**
+			 * @brief Constructs a planner for the given parameters.
+			 * @param params The parameters that describe the primary tool,
+			 * any additional tools and how the dots should be ordered.
+			 **/
+			JobPlanner( const Halftoner::CNCParameters& params );
+
+			/**
+			 * @brief Generates the g code needed to cut the given dots (no
+			 * pre/post-amble).
+			 * @param dots The dots to be cut, in raster order.
+			 * @param stats If not null, receives the extents and moves of the
+			 * g code.
+			 * @param progress Told about each row of dots; checked for
+			 * cancellation.
+			 * @return The g code, or an empty string if cancelled.
+			 **/
+			QString generate( const std::vector<Halftoner::Dot>& dots,
+												Halftoner::MoveStatistics* stats = 0,
+												const ProgressStage& progress = ProgressStage() ) const;
+
+			/// Returns the index of the tool (0 being the primary tool,
+			/// 1..n being CNCParameters::m_tools[0..n-1]) used to cut a dot of
+			/// the given size.
+			int assignTool( double dotSize ) const;
+
+			/// Returns a message for each axis on which stats go outside limits.
+			static QStringList checkTravel( const Halftoner::MoveStatistics& stats, const Halftoner::TravelLimits& limits );
+
+		private:
+			/// The g code for plunging to one depth.
+			struct Plunge
+			{
+				QString	m_code;
+				std::vector<double>	m_pecks;	/// Depth of each peck before the last pass
+				double	m_depth;
+			};
+
+			/// Everything the planner needs to know about a tool.
+			struct PlannedTool
+			{
+				int			m_number;
+				double	m_maxDiameter;	/// Largest dot diameter the tool may cut
+				double	m_depthPerSize;	/// Cut depth for a dot size of 1.0
+				double	m_peckDepth;
+				std::vector<Plunge>	m_plunges;	/// Plunge for each DepthMap level
+			};
+
+			/// Keeps track of the tool as the g code moves it.  Coordinates
+			/// are NaN until they are first set.
+			class Tracker
+			{
+				public:
+					Tracker( Halftoner::MoveStatistics& stats );
+
+					/// Records a move; coordinates that don't change are NaN.
+					void move( bool rapid, double x, double y, double z );
+
+				private:
+					Halftoner::MoveStatistics&	m_stats;
+					double	m_x, m_y, m_z;
+			};
+
+			/// Returns the plunge to the given depth, pecking if the tool calls
+			/// for it.
+			static Plunge makePlunge( const PlannedTool& tool, double depth );
+
+			/// Appends the g code for a single dot to gCode.
+			void emitDot( QString& gCode, const Halftoner::Dot& dot, const PlannedTool& tool, double& lastY, Tracker& tracker ) const;
+
+			Halftoner::CNCParameters	m_params;
+			/// The width of the largest dot that will be cut.
+			double	m_maxDotSize;
+			/// The g code that lifts the tool to the safe 'fast z' depth.
+			QString	m_liftCode;
+			/// The primary tool followed by the additional tools.
+			std::vector<PlannedTool>	m_tools;
+	};
+
+}	// namespace HTCNC
+
+
+#endif
+
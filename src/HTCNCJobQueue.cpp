@@ -0,0 +1,522 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "HTCNCJobQueue.h"
+#include "HTCNCHalftoner.h"
+#include "HTCNCLattice.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QImage>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThread>
+
+#include <vector>
+
+namespace HTCNC
+{
+	// A pool thread that keeps taking jobs from the queue until there are
+	// none left.
+	class JobQueue::Worker : public QRunnable
+	{
+		public:
+			Worker( JobQueue& queue )
+				: m_queue( queue )
+			{
+			}
+
+			virtual void run()
+			{
+				Job	job;
+
+				while ( m_queue.takeNext( job ) )
+					m_queue.run( job );
+			}
+
+		private:
+			JobQueue&	m_queue;
+	};
+
+
+	// Passes the Halftoner's progress on to its job.  (Cancelling the job
+	// cancels this directly.)
+	class JobQueue::JobProgress : public Progress
+	{
+		public:
+			JobProgress( JobQueue& queue, int id )
+				: m_queue( queue )
+				, m_id( id )
+			{
+			}
+
+		protected:
+			virtual void report( int percent )
+			{
+				// The Halftoner covers 20% to 90% of a job.
+				if ( ! m_queue.updateProgress( m_id, 20 + percent * 70 / 100 ) )
+					cancel();
+			}
+
+		private:
+			JobQueue&	m_queue;
+			int				m_id;
+	};
+
+
+	JobQueue::JobQueue( QObject* parent )
+		: QObject( parent )
+		, m_nextId(1)
+		, m_activeWorkers(0)
+		, m_turn(0)
+	{
+		m_pool.setMaxThreadCount( QThread::idealThreadCount() );
+	}
+
+
+	JobQueue::~JobQueue()
+	{
+		cancelAll();
+		m_pool.waitForDone();
+	}
+
+
+	int JobQueue::enqueue( const QString& sourceFilename,
+												 const QString& profileName,
+												 const Profile& profile,
+												 int priority,
+												 const QString& client,
+												 bool returnGCode )
+	{
+		Job	job;
+		bool	start_worker( false );
+
+		job.m_sourceFilename = sourceFilename;
+		job.m_profileName = profileName;
+		job.m_profile = profile;
+		job.m_priority = priority;
+		job.m_client = client;
+		job.m_returnGCode = returnGCode;
+
+		{
+			QMutexLocker	lock( &m_mutex );
+
+			job.m_id = m_nextId++;
+			if ( ! returnGCode )
+				job.m_outputFilename = makeOutputFilename( sourceFilename );
+			m_jobs[job.m_id] = job;
+			if ( m_activeWorkers < m_pool.maxThreadCount() )
+			{
+				++m_activeWorkers;
+				start_worker = true;
+			}
+		}
+
+		emit jobChanged( job.m_id );
+
+		if ( start_worker )
+			m_pool.start( new Worker( *this ) );
+
+		return job.m_id;
+	}
+
+
+	bool JobQueue::cancel( int id )
+	{
+		bool	now_idle( false );
+
+		{
+			QMutexLocker	lock( &m_mutex );
+			std::map<int, Job>::iterator	it( m_jobs.find( id ) );
+
+			if ( it == m_jobs.end() )
+				return false;
+
+			Job&	job( it->second );
+
+			if ( job.m_state == QUEUED )
+			{
+				job.m_state = CANCELLED;
+				job.m_outputFilename.clear();
+			}
+			else if ( job.m_state == RUNNING )
+			{
+				// The worker notices this the next time it reports progress.
+				job.m_cancelRequested = true;
+				if ( m_halftoning.count( id ) )
+					m_halftoning[id]->cancel();
+				return true;
+			}
+			else
+			{
+				return false;
+			}
+
+			now_idle = true;
+			for ( it = m_jobs.begin(); it != m_jobs.end(); ++it )
+			{
+				if ( it->second.m_state == QUEUED || it->second.m_state == RUNNING )
+					now_idle = false;
+			}
+		}
+
+		emit jobChanged( id );
+		if ( now_idle )
+			emit idle();
+		return true;
+	}
+
+
+	void JobQueue::cancelAll()
+	{
+		std::vector<int>	ids;
+
+		{
+			QMutexLocker	lock( &m_mutex );
+
+			for ( std::map<int, Job>::iterator it = m_jobs.begin(); it != m_jobs.end(); ++it )
+				ids.push_back( it->first );
+		}
+
+		for ( size_t i = 0; i < ids.size(); ++i )
+			cancel( ids[i] );
+	}
+
+
+	bool JobQueue::remove( int id )
+	{
+		QMutexLocker	lock( &m_mutex );
+		std::map<int, Job>::iterator	it( m_jobs.find( id ) );
+
+		if ( it == m_jobs.end() || it->second.m_state == QUEUED || it->second.m_state == RUNNING )
+			return false;
+
+		m_jobs.erase( it );
+		return true;
+	}
+
+
+	JobQueue::Job JobQueue::getJob( int id ) const
+	{
+		QMutexLocker	lock( &m_mutex );
+		std::map<int, Job>::const_iterator	it( m_jobs.find( id ) );
+
+		return it == m_jobs.end() ? Job() : it->second;
+	}
+
+
+	bool JobQueue::isIdle() const
+	{
+		QMutexLocker	lock( &m_mutex );
+
+		for ( std::map<int, Job>::const_iterator it = m_jobs.begin(); it != m_jobs.end(); ++it )
+		{
+			if ( it->second.m_state == QUEUED || it->second.m_state == RUNNING )
+				return false;
+		}
+		return true;
+	}
+
+
+	void JobQueue::setOutputDirectory( const QString& directory )
+	{
+		QMutexLocker	lock( &m_mutex );
+
+		m_outputDirectory = directory;
+	}
+
+
+	QString JobQueue::getOutputDirectory() const
+	{
+		QMutexLocker	lock( &m_mutex );
+
+		return m_outputDirectory;
+	}
+
+
+	void JobQueue::setMaxWorkers( int count )
+	{
+		int	start_workers( 0 );
+
+		{
+			QMutexLocker	lock( &m_mutex );
+			int	queued( 0 );
+
+			m_pool.setMaxThreadCount( qMax( 1, count ) );
+
+			// Workers are otherwise only started as jobs are added, so start
+			// enough for the jobs that are already waiting.  (Extra workers
+			// retire in takeNext() when the limit is lowered.)
+			for ( std::map<int, Job>::const_iterator it = m_jobs.begin(); it != m_jobs.end(); ++it )
+			{
+				if ( it->second.m_state == QUEUED )
+					++queued;
+			}
+			while ( m_activeWorkers < m_pool.maxThreadCount() && start_workers < queued )
+			{
+				++m_activeWorkers;
+				++start_workers;
+			}
+		}
+
+		for ( int i = 0; i < start_workers; ++i )
+			m_pool.start( new Worker( *this ) );
+	}
+
+
+	int JobQueue::getMaxWorkers() const
+	{
+		return m_pool.maxThreadCount();
+	}
+
+
+	QString JobQueue::makeOutputFilename( const QString& sourceFilename ) const
+	{
+		QFileInfo	fi( sourceFilename );
+		QString		output_dir( m_outputDirectory.isEmpty() ? fi.absolutePath() : m_outputDirectory );
+		QString		base( QDir( output_dir ).absoluteFilePath( fi.completeBaseName() ) );
+		QString		filename( base + ".ngc" );
+
+		// Two jobs writing the same file (a.png and a.jpg, or images with the
+		// same name from different directories) would overwrite each other.
+		for ( int suffix = 2; ; ++suffix )
+		{
+			bool	taken( false );
+
+			for ( std::map<int, Job>::const_iterator it = m_jobs.begin(); it != m_jobs.end() && ! taken; ++it )
+			{
+				taken = it->second.m_state != FAILED && it->second.m_state != CANCELLED &&
+								QDir::cleanPath( it->second.m_outputFilename ) == QDir::cleanPath( filename );
+			}
+			if ( ! taken )
+				return filename;
+			filename = base + "_" + QString::number( suffix ) + ".ngc";
+		}
+	}
+
+
+	bool JobQueue::takeNext( Job& job )
+	{
+		QMutexLocker	lock( &m_mutex );
+		std::map<int, Job>::iterator	best( m_jobs.end() );
+
+		// The limit may have been lowered since this worker started.
+		if ( m_activeWorkers > m_pool.maxThreadCount() )
+		{
+			--m_activeWorkers;
+			return false;
+		}
+
+		// The map is ordered by id, so the first job found with the highest
+		// priority (from the client whose last turn was longest ago) is also
+		// that client's oldest one.  Clients that haven't had a turn yet
+		// count as having had one at 0.
+		for ( std::map<int, Job>::iterator it = m_jobs.begin(); it != m_jobs.end(); ++it )
+		{
+			if ( it->second.m_state != QUEUED )
+				continue;
+			if ( best == m_jobs.end() || it->second.m_priority > best->second.m_priority ||
+					 ( it->second.m_priority == best->second.m_priority &&
+						 m_clientTurns[it->second.m_client] < m_clientTurns[best->second.m_client] ) )
+			{
+				best = it;
+			}
+		}
+
+		if ( best == m_jobs.end() )
+		{
+			// Retire the worker while the lock is held, so enqueue() knows to
+			// start a new one.
+			--m_activeWorkers;
+			return false;
+		}
+
+		best->second.m_state = RUNNING;
+		m_clientTurns[best->second.m_client] = ++m_turn;
+		job = best->second;
+		return true;
+	}
+
+
+	void JobQueue::run( Job job )
+	{
+		emit jobChanged( job.m_id );
+
+		QByteArray	source_hash( JobCache::hashFile( job.m_sourceFilename ) );
+
+		if ( source_hash.isEmpty() )
+		{
+			job.m_state = FAILED;
+			job.m_message = tr("Could not read %1.").arg( job.m_sourceFilename );
+			finish( job );
+			return;
+		}
+
+		QStringList	param_errors( Lattice::checkParameters( job.m_profile.m_params ) );
+
+		if ( ! param_errors.isEmpty() )
+		{
+			job.m_state = FAILED;
+			job.m_message = param_errors.join( " " );
+			finish( job );
+			return;
+		}
+
+		QByteArray	key( JobCache::makeKey( source_hash, job.m_profile ) );
+		QByteArray	gcode;
+
+		if ( m_cache.lookup( key, gcode, job.m_cutCount ) )
+		{
+			job.m_fromCache = true;
+		}
+		else
+		{
+			if ( ! checkpoint( job, 10 ) )
+				return;
+
+			Halftoner::CNCParameters	params( job.m_profile.m_params );
+			QImage	src( m_sources.loadForJob( job.m_sourceFilename, source_hash, params ) );
+
+			// The queue already runs a job on every core.
+			params.m_maxThreads = 1;
+			QImage	no_preview;
+
+			if ( src.isNull() )
+			{
+				job.m_state = FAILED;
+				job.m_message = tr("%1 is not a supported image.").arg( job.m_sourceFilename );
+				finish( job );
+				return;
+			}
+
+			if ( ! checkpoint( job, 20 ) )
+				return;
+
+			JobProgress	progress( *this, job.m_id );
+
+			{
+				QMutexLocker	lock( &m_mutex );
+
+				m_halftoning[job.m_id] = &progress;
+			}
+
+			Halftoner	ht( src, no_preview, 1, true, params, &progress );
+
+			{
+				QMutexLocker	lock( &m_mutex );
+
+				m_halftoning.erase( job.m_id );
+			}
+
+			gcode = ht.getGCode().toAscii();
+			job.m_cutCount = ht.getCutCount();
+
+			if ( ! checkpoint( job, 90 ) )
+				return;
+
+			// A job that would run the machine into its limits is never
+			// written (or cached).
+			if ( ! ht.getTravelErrors().isEmpty() )
+			{
+				job.m_state = FAILED;
+				job.m_message = ht.getTravelErrors().join( " " );
+				finish( job );
+				return;
+			}
+
+			// A failure to cache the job doesn't fail the job.
+			m_cache.store( key, source_hash, job.m_profileName, job.m_profile, gcode, job.m_cutCount );
+		}
+
+		if ( ! checkpoint( job, 95 ) )
+			return;
+
+		if ( job.m_returnGCode )
+		{
+			job.m_gCode = job.m_profile.formatGCodeFile( gcode );
+			job.m_outputFilename.clear();
+			job.m_state = DONE;
+		}
+		else if ( job.m_profile.writeGCodeFile( job.m_outputFilename, gcode ) )
+		{
+			job.m_state = DONE;
+		}
+		else
+		{
+			job.m_state = FAILED;
+			job.m_message = tr("Could not write %1.").arg( job.m_outputFilename );
+		}
+		finish( job );
+	}
+
+
+	bool JobQueue::updateProgress( int id, int progress )
+	{
+		{
+			QMutexLocker	lock( &m_mutex );
+			Job&	stored( m_jobs[id] );
+
+			if ( stored.m_cancelRequested )
+				return false;
+			stored.m_progress = progress;
+		}
+
+		emit jobChanged( id );
+		return true;
+	}
+
+
+	bool JobQueue::checkpoint( Job& job, int progress )
+	{
+		if ( updateProgress( job.m_id, progress ) )
+			return true;
+
+		job.m_state = CANCELLED;
+		finish( job );
+		return false;
+	}
+
+
+	void JobQueue::finish( const Job& job )
+	{
+		bool	now_idle( true );
+
+		{
+			QMutexLocker	lock( &m_mutex );
+			Job&	stored( m_jobs[job.m_id] );
+
+			stored.m_state = job.m_state;
+			stored.m_progress = ( stored.m_state == DONE ) ? 100 : stored.m_progress;
+			stored.m_outputFilename = ( stored.m_state == DONE ) ? job.m_outputFilename : QString();
+			stored.m_message = job.m_message;
+			stored.m_cutCount = job.m_cutCount;
+			stored.m_fromCache = job.m_fromCache;
+			stored.m_gCode = job.m_gCode;
+
+			for ( std::map<int, Job>::iterator it = m_jobs.begin(); it != m_jobs.end(); ++it )
+			{
+				if ( it->second.m_state == QUEUED || it->second.m_state == RUNNING )
+					now_idle = false;
+			}
+		}
+
+		emit jobChanged( job.m_id );
+		if ( now_idle )
+			emit idle();
+	}
+}
@@ -0,0 +1,208 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#ifndef HTCNCJOBQUEUE_H
+#define HTCNCJOBQUEUE_H
+
+#include "HTCNCJobCache.h"
+#include "HTCNCProfile.h"
+#include "HTCNCProgress.h"
+#include "HTCNCSourceCache.h"
+
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+
+#include <map>
+
+namespace HTCNC
+{
+
+	/*@brief Runs batches of halftoning jobs on a pool of worker threads.
+	 *
+	 * Each job is a source image plus the profile to run it with.  Jobs are
+	 * started as soon as a worker is free; when there are more jobs than
+	 * workers, jobs with a higher priority are started first.  Jobs with the
+	 * same priority are started in the order they were added, except that
+	 * the clients they were added for take turns, so one client's big batch
+	 * can't hold up everybody else.  Decoded source images are kept in a
+	 * SourceCache, so running an image again skips decoding it.  The g code
+	 * for each job is written to the output directory (or next to the source
+	 * image if no output directory is set) and added to the job cache, so
+	 * repeated jobs are served from the cache (or, if the job asks for it,
+	 * kept in the job for the caller instead).  Each job gets its own output
+	 * file: a number is added to the name if another job already has it.  Jobs that would move the
+	 * tool outside the profile's travel limits fail without writing
+	 * anything.
+	 *
+	 * The jobChanged() signal is emitted from the worker threads; connect to
+	 * it from the GUI thread and use getJob() to find out what changed.
+	 **/
+	class JobQueue : public QObject
+	{
+		Q_OBJECT
+
+		public:
+			typedef enum
+			{
+				QUEUED,
+				RUNNING,
+				DONE,
+				FAILED,
+				CANCELLED
+			} State;
+
+			struct Job
+			{
+				Job()
+					: m_id(0)
+					, m_priority(0)
+					, m_state(QUEUED)
+					, m_progress(0)
+					, m_cutCount(0)
+					, m_fromCache(false)
+					, m_returnGCode(false)
+					, m_cancelRequested(false)
+				{
+				}
+
+				int			m_id;
+				QString	m_sourceFilename;
+				QString	m_profileName;			/// Name of the profile, for display only
+				Profile	m_profile;
+				int			m_priority;					/// Higher priority jobs are started first
+				QString	m_client;						/// Who the job is for; clients take turns
+				State		m_state;
+				int			m_progress;					/// Percent complete
+				QString	m_outputFilename;		/// Where the g code is written; chosen when the job is added, cleared if it fails
+				QString	m_message;					/// Why the job failed, if it did
+				int			m_cutCount;
+				bool		m_fromCache;				/// True if the g code came from the job cache
+				bool		m_returnGCode;			/// If true, the g code is kept in m_gCode instead of being written
+				QByteArray	m_gCode;				/// The complete g code file, once done, if m_returnGCode is set
+				bool		m_cancelRequested;
+			};
+
+			/// Creates a queue whose pool has one worker per core.
+			JobQueue( QObject* parent = 0 );
+			/// Cancels all jobs and waits for the running ones to stop.
+			virtual ~JobQueue();
+
+			/**
+			 * @brief Adds a job to the queue and returns its id.
+			 * @param client Who the job is for (see Job::m_client).
+			 * @param returnGCode If true, the g code is kept in the job (see
+			 * getJob()) instead of being written to the output directory.
+			 **/
+			int enqueue( const QString& sourceFilename,
+									 const QString& profileName,
+									 const Profile& profile,
+									 int priority = 0,
+									 const QString& client = QString(),
+									 bool returnGCode = false );
+
+			/// Cancels a job.  A queued job is dropped right away; a running
+			/// job is stopped at the next opportunity and its output discarded.
+			/// Returns false if the job has already finished.
+			bool cancel( int id );
+
+			/// Cancels every job that hasn't finished.
+			void cancelAll();
+
+			/// Removes a finished job from the queue.  Returns false if the job
+			/// is still queued or running.
+			bool remove( int id );
+
+			/// Returns a copy of a job.
+			Job getJob( int id ) const;
+
+			/// Returns true if no jobs are queued or running.
+			bool isIdle() const;
+
+			/// Sets the directory the g code files of jobs added from now on are
+			/// written to.  If it is empty, each file is written next to its
+			/// source image.
+			void setOutputDirectory( const QString& directory );
+			QString getOutputDirectory() const;
+
+			/// Sets the maximum number of jobs that run at once.  Raising it
+			/// starts more of the queued jobs right away; lowering it lets the
+			/// extra workers finish their current jobs first.
+			void setMaxWorkers( int count );
+			int getMaxWorkers() const;
+
+		signals:
+			/// Emitted whenever a job's state or progress changes.
+			void jobChanged( int id );
+			/// Emitted when the last queued or running job finishes.
+			void idle();
+
+		private:
+			class Worker;
+			friend class Worker;
+			class JobProgress;
+			friend class JobProgress;
+
+			/// Hands the highest priority queued job (of the client that has
+			/// waited longest for a turn) to a worker and marks it running.
+			/// Returns false (and retires the worker) if there is nothing left
+			/// to do, or if there are more workers than the limit allows.
+			bool takeNext( Job& job );
+
+			/// Returns the file a new job's g code is written to: the source's
+			/// name with an .ngc extension, plus "_2", "_3"... if a queued,
+			/// running or finished job already writes to that file.  The mutex
+			/// must be held.
+			QString makeOutputFilename( const QString& sourceFilename ) const;
+
+			/// Runs a job on the calling worker thread.
+			void run( Job job );
+
+			/// Updates a running job's progress.  Returns false if the job has
+			/// been cancelled.
+			bool updateProgress( int id, int progress );
+
+			/// Updates a running job's progress.  If the job has been
+			/// cancelled, finishes it as cancelled and returns false.
+			bool checkpoint( Job& job, int progress );
+
+			/// Marks a job as finished.
+			void finish( const Job& job );
+
+			mutable QMutex	m_mutex;
+			std::map<int, Job>	m_jobs;
+			/// The progress objects of the jobs that are being halftoned, so
+			/// they can be cancelled.
+			std::map<int, Progress*>	m_halftoning;
+			int			m_nextId;
+			int			m_activeWorkers;
+			QString	m_outputDirectory;
+			/// When each client's last job was started (by a count of starts).
+			std::map<QString, int>	m_clientTurns;
+			int			m_turn;
+			JobCache	m_cache;
+			SourceCache	m_sources;
+			QThreadPool	m_pool;
+	};
+
+}	// namespace HTCNC
+
+
+#endif
@@ -0,0 +1,292 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "HTCNCJobServer.h"
+
+#include <QLocalSocket>
+#include <QSettings>
+#include <QTemporaryFile>
+
+namespace
+{
+	// How long (in ms) to wait for a server that may already be running to
+	// answer.
+	const int	PROBE_TIMEOUT( 1000 );
+
+	// Clients can only lower the priority of their jobs, so none of them can
+	// push ahead of the others.
+	const int	MIN_CLIENT_PRIORITY( -10 );
+	const int	MAX_CLIENT_PRIORITY( 0 );
+}
+
+
+namespace HTCNC
+{
+	JobServer::JobServer( JobQueue& queue, QObject* parent )
+		: QObject( parent )
+		, m_queue( queue )
+		, m_connectionCount(0)
+	{
+		connect( &m_server, SIGNAL(newConnection()), this, SLOT(onNewConnection()) );
+		// The queue's signals come from its worker threads.
+		connect( &m_queue, SIGNAL(jobChanged(int)), this, SLOT(onJobChanged(int)), Qt::QueuedConnection );
+	}
+
+
+	QString JobServer::defaultName()
+	{
+		return "CNCHalftoneWizard";
+	}
+
+
+	bool JobServer::listen( const QString& name )
+	{
+		if ( m_server.listen( name ) )
+			return true;
+		if ( m_server.serverError() != QAbstractSocket::AddressInUseError )
+			return false;
+
+		// A server that crashed may have left its socket behind, but the
+		// socket is only removed if nothing answers on it: taking the name
+		// from a running server would strand its clients.
+		QLocalSocket	probe;
+
+		probe.connectToServer( name );
+		if ( probe.waitForConnected( PROBE_TIMEOUT ) )
+		{
+			probe.disconnectFromServer();
+			return false;
+		}
+
+		QLocalServer::removeServer( name );
+		return m_server.listen( name );
+	}
+
+
+	QString JobServer::getServerName() const
+	{
+		return m_server.fullServerName();
+	}
+
+
+	QString JobServer::getErrorString() const
+	{
+		return m_server.errorString();
+	}
+
+
+	void JobServer::onNewConnection()
+	{
+		while ( QLocalSocket* socket = m_server.nextPendingConnection() )
+		{
+			Connection&	connection( m_connections[socket] );
+
+			connection.m_client = QString( "connection %1" ).arg( ++m_connectionCount );
+			connect( socket, SIGNAL(readyRead()), this, SLOT(onReadyRead()) );
+			connect( socket, SIGNAL(disconnected()), this, SLOT(onDisconnected()) );
+		}
+	}
+
+
+	void JobServer::onReadyRead()
+	{
+		QLocalSocket*	socket( qobject_cast<QLocalSocket*>( sender() ) );
+
+		while ( socket && socket->canReadLine() )
+			handleLine( socket, QString::fromUtf8( socket->readLine() ).trimmed() );
+	}
+
+
+	void JobServer::onDisconnected()
+	{
+		QLocalSocket*	socket( qobject_cast<QLocalSocket*>( sender() ) );
+		std::map<QLocalSocket*, Connection>::iterator	it( m_connections.find( socket ) );
+
+		if ( it == m_connections.end() )
+			return;
+
+		// Nobody is left to collect the results.  The jobs are removed from
+		// the queue as they finish.
+		std::set<int>	jobs( it->second.m_jobs );
+
+		m_connections.erase( it );
+		for ( std::set<int>::iterator job = jobs.begin(); job != jobs.end(); ++job )
+		{
+			m_owners.erase( *job );
+			if ( ! m_queue.cancel( *job ) )
+				m_queue.remove( *job );
+		}
+		socket->deleteLater();
+	}
+
+
+	void JobServer::onJobChanged( int id )
+	{
+		JobQueue::Job	job( m_queue.getJob( id ) );
+		bool	finished( job.m_state == JobQueue::DONE || job.m_state == JobQueue::FAILED || job.m_state == JobQueue::CANCELLED );
+		std::map<int, QLocalSocket*>::iterator	owner( m_owners.find( id ) );
+
+		if ( owner == m_owners.end() )
+		{
+			// Either not one of ours, or its connection has closed.
+			if ( finished && job.m_returnGCode )
+				m_queue.remove( id );
+			return;
+		}
+
+		QLocalSocket*	socket( owner->second );
+
+		if ( ! finished )
+		{
+			if ( job.m_state == JobQueue::RUNNING &&
+					 ( ! m_progress.count( id ) || m_progress[id] != job.m_progress ) )
+			{
+				m_progress[id] = job.m_progress;
+				reply( socket, QString( "progress %1 %2" ).arg( id ).arg( job.m_progress ) );
+			}
+			return;
+		}
+
+		if ( job.m_state == JobQueue::DONE )
+		{
+			reply( socket, QString( "done %1 %2 %3" ).arg( id ).arg( job.m_cutCount ).arg( job.m_gCode.size() ) );
+			socket->write( job.m_gCode );
+		}
+		else if ( job.m_state == JobQueue::FAILED )
+		{
+			reply( socket, QString( "failed %1 %2" ).arg( id ).arg( job.m_message ) );
+		}
+		else
+		{
+			reply( socket, QString( "cancelled %1" ).arg( id ) );
+		}
+
+		m_connections[socket].m_jobs.erase( id );
+		m_owners.erase( owner );
+		m_progress.erase( id );
+		m_queue.remove( id );
+	}
+
+
+	void JobServer::handleLine( QLocalSocket* socket, const QString& line )
+	{
+		Connection&	connection( m_connections[socket] );
+		QString	command( line.section( ' ', 0, 0 ) );
+		QString	argument( line.section( ' ', 1 ) );
+
+		if ( command.isEmpty() )
+			return;
+		else if ( command == "image" )
+		{
+			// Start a new request.
+			QString	client( connection.m_client );
+			std::set<int>	jobs( connection.m_jobs );
+
+			connection = Connection();
+			connection.m_client = client;
+			connection.m_jobs = jobs;
+			connection.m_image = argument;
+		}
+		else if ( command == "profile" )
+		{
+			// The name comes from any local process, so it must not reach
+			// files outside the profile directory.  The request is dropped
+			// rather than run with the wrong settings.
+			if ( ProfileStore::isValidName( argument ) )
+				connection.m_profileName = argument;
+			else
+			{
+				connection.m_image.clear();
+				reply( socket, QString( "error '%1' is not a valid profile name." ).arg( argument ) );
+			}
+		}
+		else if ( command == "set" && argument.contains( ' ' ) )
+			connection.m_settings << argument.section( ' ', 0, 0 ) << argument.section( ' ', 1 );
+		else if ( command == "priority" )
+			connection.m_priority = qBound( MIN_CLIENT_PRIORITY, argument.toInt(), MAX_CLIENT_PRIORITY );
+		else if ( command == "run" )
+			run( socket );
+		else if ( command == "cancel" )
+		{
+			int	id( argument.toInt() );
+
+			if ( ! connection.m_jobs.count( id ) || ! m_queue.cancel( id ) )
+				reply( socket, QString( "error No unfinished job %1." ).arg( argument ) );
+		}
+		else
+			reply( socket, QString( "error Unknown request '%1'." ).arg( line ) );
+	}
+
+
+	void JobServer::run( QLocalSocket* socket )
+	{
+		Connection&	connection( m_connections[socket] );
+
+		if ( connection.m_image.isEmpty() )
+		{
+			reply( socket, "error No image given." );
+			return;
+		}
+
+		QSettings	last_used;
+		Profile		profile;
+
+		profile.read( last_used );
+		if ( ! connection.m_profileName.isEmpty() && ! ProfileStore().load( connection.m_profileName, profile ) )
+		{
+			reply( socket, QString( "error No profile named '%1'." ).arg( connection.m_profileName ) );
+			return;
+		}
+
+		if ( ! connection.m_settings.isEmpty() )
+		{
+			// Profiles can only be read from settings, so the changes are
+			// written to a scratch settings file.
+			QTemporaryFile	file;
+
+			if ( ! file.open() )
+			{
+				reply( socket, "error Could not apply the settings." );
+				return;
+			}
+			file.close();
+
+			QSettings	settings( file.fileName(), QSettings::IniFormat );
+
+			for ( int i = 0; i + 1 < connection.m_settings.size(); i += 2 )
+				settings.setValue( connection.m_settings[i], connection.m_settings[i+1] );
+			profile.read( settings );
+		}
+
+		int	id( m_queue.enqueue( connection.m_image, connection.m_profileName, profile,
+														 connection.m_priority, connection.m_client, true ) );
+
+		connection.m_jobs.insert( id );
+		m_owners[id] = socket;
+		reply( socket, QString( "queued %1" ).arg( id ) );
+
+		// The settings apply to one request only.
+		connection.m_settings.clear();
+	}
+
+
+	void JobServer::reply( QLocalSocket* socket, const QString& line )
+	{
+		socket->write( line.toUtf8() + "\n" );
+	}
+}
@@ -0,0 +1,137 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#ifndef HTCNCJOBSERVER_H
+#define HTCNCJOBSERVER_H
+
+#include "HTCNCJobQueue.h"
+
+#include <QLocalServer>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+#include <map>
+#include <set>
+
+// Forward decls
+class QLocalSocket;
+
+namespace HTCNC
+{
+
+	/*@brief Takes halftoning jobs from other programs on the same machine.
+	 *
+	 * The server listens on a local socket (a named pipe under Windows)
+	 * and runs the jobs it is sent on a JobQueue, so every job shares one
+	 * pool of workers and one cache of decoded images, and the clients
+	 * don't pay for starting a process per job.  Each connection is a
+	 * client of its own, and jobs from different clients take turns on the
+	 * workers.
+	 *
+	 * The protocol is line based.  A client sends a request as:
+	 *   image <path of the source image>
+	 *   profile <name of a profile saved on the server>     (optional)
+	 *   set <settings key> <value>                          (optional, repeatable)
+	 *   priority <n>                                        (optional, -10..0)
+	 *   run
+	 * Without a profile, the server's last used settings are the starting
+	 * point; set changes a single setting, using the keys of the profile
+	 * files (e.g. "set halftone/source_pixel_step 4").  A profile name with
+	 * a path separator, a colon or ".." is an error and drops the request
+	 * (so its run is an error too).  A priority below 0
+	 * lets other jobs go first; higher ones are treated as 0, so no client
+	 * can push ahead of the rest.  "cancel <id>" cancels one of the
+	 * connection's jobs.  A connection may send any number of requests.
+	 *
+	 * The server answers with:
+	 *   queued <id>
+	 *   progress <id> <percent>
+	 *   done <id> <cut count> <size>, followed by <size> bytes of g code
+	 *   failed <id> <message>
+	 *   cancelled <id>
+	 *   error <message>                 (for a request it couldn't make sense of)
+	 * Closing the connection cancels its unfinished jobs.
+	 **/
+	class JobServer : public QObject
+	{
+		Q_OBJECT
+
+		public:
+			/// Creates a server that runs its jobs on queue.
+			JobServer( JobQueue& queue, QObject* parent = 0 );
+
+			/// Returns the name the server listens on unless told otherwise.
+			static QString defaultName();
+
+			/// Starts listening.  Returns false if the name can't be used (see
+			/// getErrorString()).
+			bool listen( const QString& name = defaultName() );
+
+			/// Returns the full name (or path) of the socket.
+			QString getServerName() const;
+
+			QString getErrorString() const;
+
+		private slots:
+			void onNewConnection();
+			void onReadyRead();
+			void onDisconnected();
+			void onJobChanged( int id );
+
+		private:
+			/// A request being put together, and the jobs a connection owns.
+			struct Connection
+			{
+				Connection()
+					: m_priority(0)
+				{
+				}
+
+				QString	m_image;
+				QString	m_profileName;
+				QStringList	m_settings;		/// Alternating keys and values
+				QString	m_client;
+				int			m_priority;
+				std::set<int>	m_jobs;
+			};
+
+			/// Handles one line from a client.
+			void handleLine( QLocalSocket* socket, const QString& line );
+
+			/// Queues the request a connection has put together.
+			void run( QLocalSocket* socket );
+
+			/// Sends a line to a client.
+			void reply( QLocalSocket* socket, const QString& line );
+
+			QLocalServer	m_server;
+			JobQueue&	m_queue;
+			std::map<QLocalSocket*, Connection>	m_connections;
+			/// The connection each job belongs to.
+			std::map<int, QLocalSocket*>	m_owners;
+			/// The last progress sent for each running job.
+			std::map<int, int>	m_progress;
+			int		m_connectionCount;
+	};
+
+}	// namespace HTCNC
+
+
+#endif
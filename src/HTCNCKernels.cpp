@@ -0,0 +1,246 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "HTCNCKernels.h"
+#include "HTCNCGreyPlane.h"
+
+#include <QImage>
+
+#include <algorithm>
+
+#include <math.h>
+#include <stdlib.h>
+
+namespace
+{
+	using HTCNC::GreyPlane;
+	using HTCNC::Lattice;
+
+	// Sums N consecutive intensities; the recursion is unrolled at compile
+	// time.
+	template <int N>
+	struct RowSum
+	{
+		static int sum( const unsigned char* p )
+		{
+			return RowSum<N-1>::sum( p ) + p[N-1];
+		}
+	};
+
+	template <>
+	struct RowSum<0>
+	{
+		static int sum( const unsigned char* )
+		{
+			return 0;
+		}
+	};
+
+
+	// getMeanIntensity() for the STEP x STEP blocks of a lattice with an
+	// even step.
+	template <int STEP>
+	int getBlockMean( const GreyPlane& src, const Lattice::Cell& cell )
+	{
+		// Blocks at the edges of the image are clipped.
+		if ( cell.m_right - cell.m_left != STEP || cell.m_bottom - cell.m_top != STEP )
+			return HTCNC::getMeanIntensity( src, cell );
+
+		const unsigned char*	row( src.getRow( cell.m_top ) + cell.m_left );
+		int	total( 0 );
+
+		for ( int j = 0; j < STEP; ++j, row += src.getStride() )
+			total += RowSum<STEP>::sum( row );
+
+		return total / ( STEP * STEP );
+	}
+
+
+	// Returns the largest a >= 0 for which a*a + dy*dy < limit, or -1.  The
+	// comparison is done exactly as the pixel-at-a-time drawing does it.
+	int halfWidth( int dy, double limit )
+	{
+		double	ddy( dy );
+
+		if ( ddy * ddy >= limit )
+			return -1;
+
+		int	a( int( sqrt( limit - ddy * ddy ) ) );
+
+		while ( a >= 0 && double( a ) * double( a ) + ddy * ddy >= limit )
+			--a;
+		while ( double( a + 1 ) * double( a + 1 ) + ddy * ddy < limit )
+			++a;
+		return a;
+	}
+
+
+	// Sets pixels [from..to] of a row.
+	template <typename Pixel>
+	void fill( Pixel* row, int from, int to, Pixel value )
+	{
+		for ( int i = from; i <= to; ++i )
+			row[i] = value;
+	}
+}
+
+
+namespace HTCNC
+{
+	int getMeanIntensity( const GreyPlane& src, const Lattice::Cell& cell )
+	{
+		int	total_intensity = 0;
+		int	pix_count = ( cell.m_right - cell.m_left ) * ( cell.m_bottom - cell.m_top );
+
+		for ( int j = cell.m_top; j < cell.m_bottom; ++j )
+		{
+			const unsigned char*	row( src.getRow( j ) );
+
+			for ( int i = cell.m_left; i < cell.m_right; ++i )
+				total_intensity += row[i];
+		}
+
+		return ( total_intensity / pix_count );
+	}
+
+
+	BlockMeanFunction getBlockMeanFunction( int step )
+	{
+		switch ( step )
+		{
+			case 2:		return &getBlockMean<2>;
+			case 4:		return &getBlockMean<4>;
+			case 6:		return &getBlockMean<6>;
+			case 8:		return &getBlockMean<8>;
+			case 10:	return &getBlockMean<10>;
+			case 12:	return &getBlockMean<12>;
+			case 16:	return &getBlockMean<16>;
+			default:	return &getMeanIntensity;
+		}
+	}
+
+
+	DotRenderer::DotRenderer( QImage& dest, double radius, int scale )
+		: m_dest( dest )
+		, m_radius( radius )
+		, m_scale( scale )
+		, m_extent( int( ceil( radius * scale ) ) + 1 )
+		, m_grey( dest.format() == QImage::Format_Indexed8 )
+		, m_direct( dest.format() == QImage::Format_RGB32 || dest.format() == QImage::Format_ARGB32 )
+	{
+	}
+
+
+	void DotRenderer::draw( const Lattice::Cell& cell, int level, double ds )
+	{
+		double	x( m_scale*cell.m_x ), y( m_scale*cell.m_y );
+		int			left( std::max( 0, int( floor( m_scale*(cell.m_x - m_radius) ) ) ) );
+		int			right( std::min( m_dest.width(), int( ceil( m_scale*(cell.m_x + m_radius) ) ) ) );
+		int			top( std::max( 0, int( floor( m_scale*(cell.m_y - m_radius) ) ) ) );
+		int			bottom( std::min( m_dest.height(), int( ceil( m_scale*(cell.m_y + m_radius) ) ) ) );
+
+		if ( level < 0 || x != floor( x ) || y != floor( y ) || ! ( m_grey || m_direct ) )
+		{
+			drawPixels( cell, ds, left, right, top, bottom );
+			return;
+		}
+
+		const Spans&	spans( getSpans( level, ds ) );
+
+		if ( m_grey )
+			drawSpans<uchar>( spans, int( x ), int( y ), left, right, top, bottom, 255, 127 );
+		else
+			drawSpans<QRgb>( spans, int( x ), int( y ), left, right, top, bottom, qRgb( 255, 255, 255 ), qRgb( 127, 127, 127 ) );
+	}
+
+
+	const DotRenderer::Spans& DotRenderer::getSpans( int level, double ds )
+	{
+		if ( level >= int( m_spans.size() ) )
+			m_spans.resize( level + 1 );
+
+		Spans&	spans( m_spans[level] );
+
+		if ( spans.m_grey.empty() )
+		{
+			double	ds2( m_radius*m_radius*ds*ds*m_scale*m_scale );
+
+			spans.m_white.resize( m_extent + 1 );
+			spans.m_grey.resize( m_extent + 1 );
+			for ( int dy = 0; dy <= m_extent; ++dy )
+			{
+				spans.m_white[dy] = halfWidth( dy, ds2 - 0.5 );
+				spans.m_grey[dy] = halfWidth( dy, ds2 + 0.5 );
+			}
+		}
+		return spans;
+	}
+
+
+	template <typename Pixel>
+	void DotRenderer::drawSpans( const Spans& spans, int x, int y, int left, int right, int top, int bottom, Pixel white, Pixel grey )
+	{
+		for ( int j = top; j < bottom; ++j )
+		{
+			int	dy( abs( j - y ) );
+
+			if ( dy > m_extent || spans.m_grey[dy] < 0 )
+				continue;
+
+			Pixel*	row( reinterpret_cast<Pixel*>( m_dest.scanLine( j ) ) );
+			int	w( spans.m_white[dy] ), g( spans.m_grey[dy] );
+			int	from( std::max( left, x - g ) ), to( std::min( right - 1, x + g ) );
+
+			// Grey border, white middle, grey border.
+			fill( row, from, std::min( to, x - w - 1 ), grey );
+			fill( row, std::max( from, x - w ), std::min( to, x + w ), white );
+			fill( row, std::max( from, x + w + 1 ), to, grey );
+		}
+	}
+
+
+	void DotRenderer::drawPixels( const Lattice::Cell& cell, double ds, int left, int right, int top, int bottom )
+	{
+		double	ds2( m_radius*m_radius*ds*ds*m_scale*m_scale );
+		double	x( m_scale*cell.m_x ), y( m_scale*cell.m_y );
+
+		for ( int j = top; j < bottom; ++j )
+		{
+			uchar*	line( m_grey ? m_dest.scanLine( j ) : 0 );
+
+			for ( int i = left; i < right; ++i )
+			{
+				double dx( i - x ), dy( j - y );
+				int		value;
+
+				if ( dx * dx + dy * dy < ds2 - 0.5 )
+					value = 255;
+				// Make the border pixels grey to improve the appearance a bit.
+				else if ( dx * dx + dy * dy < ds2 + 0.5 )
+					value = 127;
+				else
+					continue;
+
+				if ( m_grey )
+					line[i] = uchar( value );
+				else
+					m_dest.setPixel( i, j, qRgb( value, value, value ) );
+			}
+		}
+	}
+}
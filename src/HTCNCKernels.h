@@ -0,0 +1,117 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#ifndef HTCNCKERNELS_H
+#define HTCNCKERNELS_H
+
+#include "HTCNCLattice.h"
+
+#include <vector>
+
+// Forward decls
+class QImage;
+
+namespace HTCNC
+{
+	class GreyPlane;
+
+	/**
+	 * @brief Returns the mean intensity of a cell's sampling block, in the
+	 * range [0..255] (the mean is truncated).
+	 * @param src The source image.
+	 * @param cell The cell; its block has already been clipped to the image.
+	 **/
+	int getMeanIntensity( const GreyPlane& src, const Lattice::Cell& cell );
+
+	/// A function that does the same as getMeanIntensity().
+	typedef int (*BlockMeanFunction)( const GreyPlane& src, const Lattice::Cell& cell );
+
+	/**
+	 * @brief Returns the fastest way to average the blocks of a lattice laid
+	 * out with the given pixel step.
+	 * The common even steps (2, 4, 6, 8, 10, 12 and 16) have kernels whose
+	 * loops are unrolled at compile time; any other step, and any block
+	 * clipped by the edge of the image, uses getMeanIntensity().
+	 **/
+	BlockMeanFunction getBlockMeanFunction( int step );
+
+
+	/*@brief Draws dots in a preview image.
+	 *
+	 * A dot is a white disc with a grey border.  When a dot's center lands
+	 * on a whole pixel (as it does in the square and offset lattices), its
+	 * shape only depends on its size, so for each dot level the renderer
+	 * works out once which span of each row is white and which is grey, and
+	 * then just fills the spans for every dot at that level.  Other dots are
+	 * drawn a pixel at a time.
+	 **/
+	class DotRenderer
+	{
+		public:
+			/**
+			 * @brief Constructs a renderer.
+			 * @param dest The preview image: 32-bit, or Indexed8 with a grey
+			 * ramp color table.
+			 * @param radius The radius of a full-sized dot in source pixels.
+			 * @param scale The scale of the preview.
+			 **/
+			DotRenderer( QImage& dest, double radius, int scale );
+
+			/**
+			 * @brief Draws a dot.
+			 * @param cell The cell the dot belongs to.
+			 * @param level The dot's level; every dot at a level is the same size.
+			 * @param ds The size of the dot, in the range (0..1].
+			 **/
+			void draw( const Lattice::Cell& cell, int level, double ds );
+
+		private:
+			/// The shape of a dot: for each distance from the center row, the
+			/// half width of the white and of the grey (border included) part
+			/// of the row, or -1 if there is none.
+			struct Spans
+			{
+				std::vector<int>	m_white;
+				std::vector<int>	m_grey;
+			};
+
+			/// Returns the shape of the dots at a level, working it out the
+			/// first time.
+			const Spans& getSpans( int level, double ds );
+
+			/// Fills the spans of a dot centered on pixel (x, y).
+			template <typename Pixel>
+			void drawSpans( const Spans& spans, int x, int y, int left, int right, int top, int bottom, Pixel white, Pixel grey );
+
+			/// Draws a dot a pixel at a time.
+			void drawPixels( const Lattice::Cell& cell, double ds, int left, int right, int top, int bottom );
+
+			QImage&	m_dest;
+			double	m_radius;
+			double	m_scale;
+			int			m_extent;				/// The farthest a dot reaches from its center, in pixels
+			bool		m_grey;					/// True if m_dest is 8 bit grey
+			bool		m_direct;				/// True if m_dest is 32-bit
+			std::vector<Spans>	m_spans;	/// By level; empty until needed
+	};
+
+}	// namespace HTCNC
+
+
+#endif
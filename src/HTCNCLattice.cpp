@@ -0,0 +1,363 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "HTCNCLattice.h"
+
+#include <QObject>
+
+#include <algorithm>
+
+#include <math.h>
+
+namespace HTCNC
+{
+	Lattice::Lattice( const Halftoner::CNCParameters& params, int width, int height )
+		: m_width( width )
+		, m_height( height )
+		, m_sampleRadius( params.m_step/2 )
+		, m_rows( 0 )
+		, m_columns( 0 )
+		, m_dotRadius( params.m_step/2 )
+		, m_fitted( params.m_outputWidth > 0 || params.m_outputHeight > 0 )
+		, m_outputWidth( 0 )
+		, m_outputHeight( 0 )
+		, m_scaleX( 0 )
+		, m_scaleY( 0 )
+		, m_sampleWidth( 0 )
+		, m_sampleHeight( 0 )
+	{
+		if ( m_fitted )
+		{
+			layOutFitted( params );
+			countGrid();
+			return;
+		}
+
+		const int	step( params.m_step );
+		double	max_dot_size( params.m_fullToolWidth * params.m_maxCutPercent );
+		double	pitch( max_dot_size + params.m_minDotGap );
+
+		switch ( params.m_lattice )
+		{
+			case Halftoner::SQUARE:
+			{
+				for ( int r = 0, y = step/2; y < height; ++r, y+=step )
+				{
+					for ( int c = 0, x = step/2; x < width; ++c, x+=step )
+						addCell( x, y, r, c, pitch / step );
+				}
+				break;
+			}
+
+			case Halftoner::HEXAGONAL:
+			{
+				// Rows are a step apart and dots within a row are 2/sqrt(3) steps
+				// apart, which covers the image with the same resolution as a
+				// square grid of the same step using about 13% fewer dots.  A
+				// step is still a pitch in the output, like every other lattice,
+				// so the output is the same size; the dots in a row just end up
+				// a little further apart than the pitch.
+				double	spacing( 2.0 * step / sqrt( 3.0 ) );
+
+				for ( int r = 0, y = step/2; y < height; ++r, y+=step )
+				{
+					double	x( r % 2 ? spacing : spacing / 2 );
+
+					for ( int c = 0; x < width; ++c, x+=spacing )
+						addCell( x, y, r, c, pitch / step );
+				}
+				break;
+			}
+
+			case Halftoner::ROTATED:
+			{
+				// A square grid rotated about the center of the image.
+				double	angle( params.m_screenAngle * 3.14159265358979323846 / 180.0 );
+				double	ux( cos( angle ) * step ), uy( sin( angle ) * step );
+				double	cx( width / 2.0 ), cy( height / 2.0 );
+				int			n( int( ceil( sqrt( cx * cx + cy * cy ) / step ) ) );
+
+				for ( int j = -n; j <= n; ++j )
+				{
+					for ( int i = -n; i <= n; ++i )
+						addCell( cx + i * ux - j * uy, cy + i * uy + j * ux, j, i, pitch / step );
+				}
+				shiftGrid();
+				break;
+			}
+
+			case Halftoner::OFFSET_ROWS:
+			default:
+			{
+				// Every other row is offset by half a step to achieve the zig-zag
+				// pattern of a typical halftone image.
+				for ( int r = 0, y = step/2, cy = height/step; y < height; ++r, y+=step, --cy )
+				{
+					int	offset( r % 2 ? 0 : step/2 );
+
+					for ( int c = 0, x = offset; x < width; ++c, x+=step )
+					{
+						addCell( x, y, r, c, 0 );
+
+						Cell&	cell( m_cells.back() );
+
+						cell.m_cutX = ( c + 1 ) * pitch;
+						if ( offset )
+							cell.m_cutX -= max_dot_size / 2.0;
+						cell.m_cutY = cy * pitch;
+					}
+				}
+				break;
+			}
+		}
+
+		countGrid();
+	}
+
+
+	void Lattice::getOutputSize( const Halftoner::CNCParameters& params, int width, int height,
+															 double& outputWidth, double& outputHeight )
+	{
+		outputWidth = 0;
+		outputHeight = 0;
+		if ( width <= 0 || height <= 0 )
+			return;
+
+		if ( params.m_outputWidth > 0 || params.m_outputHeight > 0 )
+		{
+			// Whichever side isn't given follows from the image's aspect ratio.
+			// If both are, the image is fitted inside them without stretching
+			// it, so a dot always samples a square (or hexagonal) patch.
+			outputWidth = params.m_outputWidth;
+			outputHeight = params.m_outputHeight;
+			if ( outputWidth <= 0 )
+				outputWidth = outputHeight * width / height;
+			else if ( outputHeight <= 0 )
+				outputHeight = outputWidth * height / width;
+			else if ( outputWidth * height > outputHeight * width )
+				outputWidth = outputHeight * width / height;
+			else
+				outputHeight = outputWidth * height / width;
+			return;
+		}
+
+		// Each step of source pixels becomes one dot pitch, whatever the lattice.
+		double	pitch( getPitch( params ) );
+
+		outputWidth = width * pitch / params.m_step;
+		outputHeight = height * pitch / params.m_step;
+	}
+
+
+	void Lattice::addCell( double x, double y, int row, int column, double outputScale )
+	{
+		if ( x < 0 || x >= m_width || y < 0 || y >= m_height )
+			return;
+
+		Cell	cell;
+		int		ix( int( floor( x + 0.5 ) ) );
+		int		iy( int( floor( y + 0.5 ) ) );
+
+		cell.m_x = x;
+		cell.m_y = y;
+		cell.m_left = std::max( 0, ix - m_sampleRadius );
+		cell.m_top = std::max( 0, iy - m_sampleRadius );
+		cell.m_right = std::min( m_width, ix + m_sampleRadius );
+		cell.m_bottom = std::min( m_height, iy + m_sampleRadius );
+		// Make sure at least the center pixel is sampled.
+		if ( cell.m_right <= cell.m_left )
+			cell.m_right = std::min( m_width, cell.m_left + 1 );
+		if ( cell.m_bottom <= cell.m_top )
+			cell.m_bottom = std::min( m_height, cell.m_top + 1 );
+		cell.m_sampleLeft = cell.m_left;
+		cell.m_sampleTop = cell.m_top;
+		cell.m_sampleRight = cell.m_right;
+		cell.m_sampleBottom = cell.m_bottom;
+		cell.m_cutX = x * outputScale;
+		cell.m_cutY = ( m_height - y ) * outputScale;
+		cell.m_row = row;
+		cell.m_column = column;
+		m_cells.push_back( cell );
+	}
+
+
+	double Lattice::getPitch( const Halftoner::CNCParameters& params )
+	{
+		if ( ( params.m_outputWidth > 0 || params.m_outputHeight > 0 ) && params.m_dotPitch > 0 )
+			return params.m_dotPitch;
+		return params.m_fullToolWidth * params.m_maxCutPercent + params.m_minDotGap;
+	}
+
+
+	QStringList Lattice::checkParameters( const Halftoner::CNCParameters& params )
+	{
+		double	max_dot_size( params.m_fullToolWidth * params.m_maxCutPercent );
+		double	pitch( getPitch( params ) );
+		QStringList	errors;
+
+		// Without a dot pitch of its own, the pitch is the largest dot plus
+		// the gap the user asked for.
+		if ( pitch != params.m_dotPitch )
+			return errors;
+
+		if ( pitch < max_dot_size )
+		{
+			errors << QObject::tr("The dot pitch (%1) is smaller than the largest dot (%2), so the darkest dots would be cut into each other.")
+									.arg( pitch ).arg( max_dot_size );
+		}
+		return errors;
+	}
+
+
+	void Lattice::layOutFitted( const Halftoner::CNCParameters& params )
+	{
+		getOutputSize( params, m_width, m_height, m_outputWidth, m_outputHeight );
+		if ( m_outputWidth <= 0 || m_outputHeight <= 0 )
+			return;
+
+		double	pitch( getPitch( params ) );
+
+		if ( pitch <= 0 )
+			return;
+
+		m_scaleX = m_width / m_outputWidth;
+		m_scaleY = m_height / m_outputHeight;
+		m_dotRadius = pitch / 2 * m_scaleX;
+		// By default each cell samples the pitch x pitch square around it.
+		m_sampleWidth = pitch;
+		m_sampleHeight = pitch;
+
+		switch ( params.m_lattice )
+		{
+			case Halftoner::SQUARE:
+			{
+				for ( int r = 0; pitch / 2 + r * pitch < m_outputHeight; ++r )
+				{
+					for ( int c = 0; pitch / 2 + c * pitch < m_outputWidth; ++c )
+						addFittedCell( pitch / 2 + c * pitch, pitch / 2 + r * pitch, r, c );
+				}
+				break;
+			}
+
+			case Halftoner::HEXAGONAL:
+			{
+				// Dots are a pitch apart within a row and rows are sqrt(3)/2
+				// pitches apart, so every dot is a pitch from its six neighbors.
+				double	row_spacing( pitch * sqrt( 3.0 ) / 2 );
+
+				m_sampleHeight = row_spacing;
+				for ( int r = 0; row_spacing / 2 + r * row_spacing < m_outputHeight; ++r )
+				{
+					double	v( row_spacing / 2 + r * row_spacing );
+					double	u( r % 2 ? pitch : pitch / 2 );
+
+					for ( int c = 0; u < m_outputWidth; ++c, u+=pitch )
+						addFittedCell( u, v, r, c );
+				}
+				break;
+			}
+
+			case Halftoner::ROTATED:
+			{
+				// A square grid rotated about the center of the output.
+				double	angle( params.m_screenAngle * 3.14159265358979323846 / 180.0 );
+				double	ux( cos( angle ) * pitch ), uy( sin( angle ) * pitch );
+				double	cx( m_outputWidth / 2.0 ), cy( m_outputHeight / 2.0 );
+				int			n( int( ceil( sqrt( cx * cx + cy * cy ) / pitch ) ) );
+
+				for ( int j = -n; j <= n; ++j )
+				{
+					for ( int i = -n; i <= n; ++i )
+						addFittedCell( cx + i * ux - j * uy, cy + i * uy + j * ux, j, i );
+				}
+				shiftGrid();
+				break;
+			}
+
+			case Halftoner::OFFSET_ROWS:
+			default:
+			{
+				// Every other row is offset by half a pitch.
+				for ( int r = 0; pitch / 2 + r * pitch < m_outputHeight; ++r )
+				{
+					double	v( pitch / 2 + r * pitch );
+					double	u( r % 2 ? pitch : pitch / 2 );
+
+					for ( int c = 0; u < m_outputWidth; ++c, u+=pitch )
+						addFittedCell( u, v, r, c );
+				}
+				break;
+			}
+		}
+	}
+
+
+	void Lattice::addFittedCell( double u, double v, int row, int column )
+	{
+		if ( u < 0 || u >= m_outputWidth || v < 0 || v >= m_outputHeight )
+			return;
+
+		Cell	cell;
+
+		cell.m_x = u * m_scaleX;
+		cell.m_y = v * m_scaleY;
+		cell.m_sampleLeft = std::max( 0.0, cell.m_x - m_sampleWidth / 2 * m_scaleX );
+		cell.m_sampleTop = std::max( 0.0, cell.m_y - m_sampleHeight / 2 * m_scaleY );
+		cell.m_sampleRight = std::min( double( m_width ), cell.m_x + m_sampleWidth / 2 * m_scaleX );
+		cell.m_sampleBottom = std::min( double( m_height ), cell.m_y + m_sampleHeight / 2 * m_scaleY );
+		// The whole pixels touched by the sample area.
+		cell.m_left = int( floor( cell.m_sampleLeft ) );
+		cell.m_top = int( floor( cell.m_sampleTop ) );
+		cell.m_right = std::max( cell.m_left + 1, int( ceil( cell.m_sampleRight ) ) );
+		cell.m_bottom = std::max( cell.m_top + 1, int( ceil( cell.m_sampleBottom ) ) );
+		cell.m_cutX = u;
+		cell.m_cutY = m_outputHeight - v;
+		cell.m_row = row;
+		cell.m_column = column;
+		m_cells.push_back( cell );
+	}
+
+
+	void Lattice::shiftGrid()
+	{
+		int	min_row( 0 ), min_column( 0 );
+
+		for ( size_t k = 0; k < m_cells.size(); ++k )
+		{
+			if ( k == 0 || m_cells[k].m_row < min_row )
+				min_row = m_cells[k].m_row;
+			if ( k == 0 || m_cells[k].m_column < min_column )
+				min_column = m_cells[k].m_column;
+		}
+		for ( size_t k = 0; k < m_cells.size(); ++k )
+		{
+			m_cells[k].m_row -= min_row;
+			m_cells[k].m_column -= min_column;
+		}
+	}
+
+
+	void Lattice::countGrid()
+	{
+		for ( size_t k = 0; k < m_cells.size(); ++k )
+		{
+			m_rows = std::max( m_rows, m_cells[k].m_row + 1 );
+			m_columns = std::max( m_columns, m_cells[k].m_column + 1 );
+		}
+	}
+}
@@ -0,0 +1,169 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#ifndef HTCNCLATTICE_H
+#define HTCNCLATTICE_H
+
+#include "HTCNCHalftoner.h"
+
+#include <vector>
+
+namespace HTCNC
+{
+
+	/*@brief The layout of the halftone cells over the source image.
+	 *
+	 * All of the geometry for a cell (its center, the block of source pixels
+	 * that is averaged to size it and where it ends up in the g code) is
+	 * computed once here, and the sampling, preview and g code stages just
+	 * walk the list.
+	 *
+	 * Normally cells are laid out every m_step source pixels and the output
+	 * size follows from that.  If an output size is given instead, the cells
+	 * are laid out a dot pitch apart in output units and mapped back onto
+	 * the source, so cells generally fall between pixels and cover a
+	 * fractional number of them.
+	 *
+	 * Every cell also has a row and column in a rows x columns grid so that
+	 * the dot modulator can find its neighbors.  Cells are listed in row-major
+	 * order, which is the order the job planner expects.
+	 **/
+	class Lattice
+	{
+		public:
+			struct Cell
+			{
+				double	m_x;			/// Center of the cell in source pixels
+				double	m_y;
+				int			m_left;		/// Block of source pixels sampled for the cell
+				int			m_top;		/// (right and bottom are exclusive; the block
+				int			m_right;	/// is already clipped to the image)
+				int			m_bottom;
+				double	m_sampleLeft;		/// The exact area sampled for the cell; only
+				double	m_sampleTop;		/// differs from the block above if isFitted()
+				double	m_sampleRight;
+				double	m_sampleBottom;
+				double	m_cutX;		/// Position of the cut in output units
+				double	m_cutY;
+				int			m_row;		/// Position of the cell in the grid
+				int			m_column;
+			};
+
+			/**
+			 * @brief Lays out the cells for an image of the given size.
+			 * @param params The lattice type, step, screen angle and the tool
+			 * geometry (which determines the dot pitch in output units).
+			 * @param width The width of the source image in pixels.
+			 * @param height The height of the source image in pixels.
+			 **/
+			Lattice( const Halftoner::CNCParameters& params, int width, int height );
+
+			/**
+			 * @brief Computes the size of the output.
+			 * @param params As for the constructor.
+			 * @param width, height The size of the source image in pixels.
+			 * @param outputWidth, outputHeight Receive the size of the output.
+			 * With both an output width and height, this is the largest size
+			 * with the image's aspect ratio that fits within them.
+			 **/
+			static void getOutputSize( const Halftoner::CNCParameters& params, int width, int height,
+																 double& outputWidth, double& outputHeight );
+
+			/// Returns the distance between neighboring dots in output units.
+			/// params.m_dotPitch only applies when fitting an output size.
+			static double getPitch( const Halftoner::CNCParameters& params );
+
+			/// Returns the reasons why params can't be used to cut a job, or an
+			/// empty list if they can: a dot pitch (params.m_dotPitch) that is
+			/// smaller than the largest dot would cut the darkest dots into
+			/// each other.
+			static QStringList checkParameters( const Halftoner::CNCParameters& params );
+
+			/// Returns true if the lattice was fitted to an output size, in
+			/// which case the cells' exact sample areas should be used.
+			bool isFitted() const
+			{
+				return m_fitted;
+			}
+
+			/// Returns the cells in row-major order.
+			const std::vector<Cell>& getCells() const
+			{
+				return m_cells;
+			}
+
+			/// Returns the number of rows in the cell grid.
+			int getRows() const
+			{
+				return m_rows;
+			}
+
+			/// Returns the number of columns in the cell grid.
+			int getColumns() const
+			{
+				return m_columns;
+			}
+
+			/// Returns the radius, in source pixels, of a full-sized dot.
+			double getDotRadius() const
+			{
+				return m_dotRadius;
+			}
+
+		private:
+			/// Adds a cell centered on (x, y) if the center is on the image.
+			void addCell( double x, double y, int row, int column, double outputScale );
+
+			/// Lays out the cells in output units to fit params.m_outputWidth/
+			/// m_outputHeight.
+			void layOutFitted( const Halftoner::CNCParameters& params );
+
+			/// Adds a cell centered on (u, v) in output units (measured from
+			/// the top left) if it is on the output.
+			void addFittedCell( double u, double v, int row, int column );
+
+			/// Renumbers the rows and columns so that they start at 0.
+			void shiftGrid();
+
+			/// Sets m_rows and m_columns from the cells.
+			void countGrid();
+
+			int			m_width;
+			int			m_height;
+			/// Half the size of the block of pixels averaged for each cell.
+			int			m_sampleRadius;
+			int			m_rows;
+			int			m_columns;
+			double	m_dotRadius;
+			bool		m_fitted;
+			// Only used when fitting an output size:
+			double	m_outputWidth;
+			double	m_outputHeight;
+			double	m_scaleX;				/// Source pixels per output unit
+			double	m_scaleY;
+			double	m_sampleWidth;	/// Size of a cell's sample area in output units
+			double	m_sampleHeight;
+			std::vector<Cell>	m_cells;
+	};
+
+}	// namespace HTCNC
+
+
+#endif
+
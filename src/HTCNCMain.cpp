@@ -18,10 +18,24 @@
 
 #include "HTCNCMainWindow.h"
 #include "HTCNCConsole.h"
+#include "HTCNCGCodeSimulator.h"
+#include "HTCNCHalftoner.h"
+#include "HTCNCImageLoader.h"
+#include "HTCNCJobQueue.h"
+#include "HTCNCJobServer.h"
+#include "HTCNCLattice.h"
+#include "HTCNCProfile.h"
+#include "HTCNCProgress.h"
 
 #include "ui_MainWindow.h"
 
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QLocalSocket>
 #include <QMessageBox>
+#include <QSettings>
+#include <QStringList>
 
 
 #include <iostream>
@@ -53,13 +67,337 @@ void qtMessageHandler(QtMsgType type, const char *msg)
 }
 
 
+// Halftones a single image without the GUI, reporting progress on stderr:
+//   CNCHalftoneWizard --gcode <image> [<output file>] [--profile <name>]
+// The settings from the last time the GUI was run are used unless a saved
+// profile is named.  The output file defaults to the image's name with a
+// .ngc extension.  Returns 0 on success, 2 if the job would go outside the
+// machine's travel limits or its settings can't be cut (nothing is written)
+// and 1 for any other error.
+int runHeadless( const QStringList& args )
+{
+	QString	source_filename;
+	QString	output_filename;
+	QString	profile_name;
+
+	for ( int i = 1; i < args.size(); ++i )
+	{
+		if ( args[i] == "--gcode" )
+			continue;
+		else if ( args[i] == "--profile" && i + 1 < args.size() )
+			profile_name = args[++i];
+		else if ( source_filename.isEmpty() )
+			source_filename = args[i];
+		else if ( output_filename.isEmpty() )
+			output_filename = args[i];
+	}
+
+	if ( source_filename.isEmpty() )
+	{
+		std::cerr << "Usage: CNCHalftoneWizard --gcode <image> [<output file>] [--profile <name>]" << std::endl;
+		return 1;
+	}
+
+	if ( output_filename.isEmpty() )
+	{
+		QFileInfo	fi( source_filename );
+
+		output_filename = fi.absolutePath() + "/" + fi.completeBaseName() + ".ngc";
+	}
+
+	QSettings				settings;
+	HTCNC::Profile	profile;
+
+	profile.read( settings );
+	if ( ! profile_name.isEmpty() && ! HTCNC::ProfileStore().load( profile_name, profile ) )
+	{
+		std::cerr << "Could not load profile '" << profile_name.toLocal8Bit().constData() << "'." << std::endl;
+		return 1;
+	}
+
+	QStringList	param_errors( HTCNC::Lattice::checkParameters( profile.m_params ) );
+
+	if ( ! param_errors.isEmpty() )
+	{
+		std::cerr << "Not writing " << output_filename.toLocal8Bit().constData() << ":" << std::endl;
+		for ( int i = 0; i < param_errors.size(); ++i )
+			std::cerr << "  " << param_errors[i].toLocal8Bit().constData() << std::endl;
+		return 2;
+	}
+
+	HTCNC::Halftoner::CNCParameters	params( profile.m_params );
+	QImage	src( HTCNC::ImageLoader( source_filename ).loadForJob( params ) );
+	QImage	no_preview;
+
+	if ( src.isNull() )
+	{
+		std::cerr << "Could not read " << source_filename.toLocal8Bit().constData() << "." << std::endl;
+		return 1;
+	}
+
+	HTCNC::StderrProgress	progress( QFileInfo( source_filename ).fileName() );
+	HTCNC::Halftoner	ht( src, no_preview, 1, true, params, &progress );
+
+	if ( ! ht.getTravelErrors().isEmpty() )
+	{
+		std::cerr << "Not writing " << output_filename.toLocal8Bit().constData() << ":" << std::endl;
+		for ( int i = 0; i < ht.getTravelErrors().size(); ++i )
+			std::cerr << "  " << ht.getTravelErrors()[i].toLocal8Bit().constData() << std::endl;
+		return 2;
+	}
+
+	if ( ! profile.writeGCodeFile( output_filename, ht.getGCode().toAscii() ) )
+	{
+		std::cerr << "Could not write " << output_filename.toLocal8Bit().constData() << "." << std::endl;
+		return 1;
+	}
+
+	std::cerr << ht.getCutCount() << " cuts written to " << output_filename.toLocal8Bit().constData() << "." << std::endl;
+	return 0;
+}
+
+
+// Checks a g code file without the GUI:
+//   CNCHalftoneWizard --verify <g code file> [<image file>] [--profile <name>]
+// The cuts are sized using the tools in the last used settings (or the named
+// profile).  The summary goes to stdout and progress to stderr; if an image
+// file is given, the cuts are drawn to it.  Returns 0 if the file passes, 2
+// if it has errors and 1 if it couldn't be checked at all.
+int runVerify( const QStringList& args )
+{
+	QString	gcode_filename;
+	QString	image_filename;
+	QString	profile_name;
+
+	for ( int i = 1; i < args.size(); ++i )
+	{
+		if ( args[i] == "--verify" )
+			continue;
+		else if ( args[i] == "--profile" && i + 1 < args.size() )
+			profile_name = args[++i];
+		else if ( gcode_filename.isEmpty() )
+			gcode_filename = args[i];
+		else if ( image_filename.isEmpty() )
+			image_filename = args[i];
+	}
+
+	if ( gcode_filename.isEmpty() )
+	{
+		std::cerr << "Usage: CNCHalftoneWizard --verify <g code file> [<image file>] [--profile <name>]" << std::endl;
+		return 1;
+	}
+
+	QSettings				settings;
+	HTCNC::Profile	profile;
+
+	profile.read( settings );
+	if ( ! profile_name.isEmpty() && ! HTCNC::ProfileStore().load( profile_name, profile ) )
+	{
+		std::cerr << "Could not load profile '" << profile_name.toLocal8Bit().constData() << "'." << std::endl;
+		return 1;
+	}
+
+	QFile	file( gcode_filename );
+
+	if ( ! file.open( QIODevice::ReadOnly ) )
+	{
+		std::cerr << "Could not read " << gcode_filename.toLocal8Bit().constData() << "." << std::endl;
+		return 1;
+	}
+
+	HTCNC::StderrProgress		progress( QFileInfo( gcode_filename ).fileName() );
+	HTCNC::GCodeSimulator		simulator( profile.m_params );
+	bool	passed( simulator.run( file, &progress ) );
+
+	std::cout << simulator.getSummary().toLocal8Bit().constData();
+
+	if ( ! image_filename.isEmpty() && ! simulator.render( 1000 ).save( image_filename ) )
+		std::cerr << "Could not write " << image_filename.toLocal8Bit().constData() << "." << std::endl;
+
+	return passed ? 0 : 2;
+}
+
+
+// Runs a job server until the process is killed:
+//   CNCHalftoneWizard --serve [<server name>] [--workers <n>]
+// See HTCNCJobServer.h for the protocol.
+int runServer( const QStringList& args )
+{
+	QString	server_name( HTCNC::JobServer::defaultName() );
+	int			workers( 0 );
+
+	for ( int i = 1; i < args.size(); ++i )
+	{
+		if ( args[i] == "--serve" )
+			continue;
+		else if ( args[i] == "--workers" && i + 1 < args.size() )
+			workers = args[++i].toInt();
+		else
+			server_name = args[i];
+	}
+
+	HTCNC::JobQueue		queue;
+	HTCNC::JobServer	server( queue );
+
+	if ( workers > 0 )
+		queue.setMaxWorkers( workers );
+
+	if ( ! server.listen( server_name ) )
+	{
+		std::cerr << "Could not listen on " << server_name.toLocal8Bit().constData() << ": "
+							<< server.getErrorString().toLocal8Bit().constData() << std::endl;
+		return 1;
+	}
+
+	std::cerr << "Serving jobs on " << server.getServerName().toLocal8Bit().constData()
+						<< " with " << queue.getMaxWorkers() << " workers." << std::endl;
+	return QCoreApplication::exec();
+}
+
+
+// Hands a single image to a job server and writes the g code it sends back:
+//   CNCHalftoneWizard --submit <image> [<output file>] [--profile <name>] [--server <name>]
+// The profile is one saved on the server.  Returns 0 on success, 2 if the
+// server couldn't run the job and 1 if the server couldn't be reached.
+int runSubmit( const QStringList& args )
+{
+	QString	source_filename;
+	QString	output_filename;
+	QString	profile_name;
+	QString	server_name( HTCNC::JobServer::defaultName() );
+
+	for ( int i = 1; i < args.size(); ++i )
+	{
+		if ( args[i] == "--submit" )
+			continue;
+		else if ( args[i] == "--profile" && i + 1 < args.size() )
+			profile_name = args[++i];
+		else if ( args[i] == "--server" && i + 1 < args.size() )
+			server_name = args[++i];
+		else if ( source_filename.isEmpty() )
+			source_filename = args[i];
+		else if ( output_filename.isEmpty() )
+			output_filename = args[i];
+	}
+
+	if ( source_filename.isEmpty() )
+	{
+		std::cerr << "Usage: CNCHalftoneWizard --submit <image> [<output file>] [--profile <name>] [--server <name>]" << std::endl;
+		return 1;
+	}
+
+	QFileInfo	fi( source_filename );
+
+	if ( output_filename.isEmpty() )
+		output_filename = fi.absolutePath() + "/" + fi.completeBaseName() + ".ngc";
+
+	QLocalSocket	socket;
+
+	socket.connectToServer( server_name );
+	if ( ! socket.waitForConnected( 5000 ) )
+	{
+		std::cerr << "Could not connect to " << server_name.toLocal8Bit().constData() << "." << std::endl;
+		return 1;
+	}
+
+	// The server may not share our working directory.
+	QString	request( "image " + fi.absoluteFilePath() + "\n" );
+
+	if ( ! profile_name.isEmpty() )
+		request += "profile " + profile_name + "\n";
+	request += "run\n";
+	socket.write( request.toUtf8() );
+
+	HTCNC::StderrProgress	progress( fi.fileName() );
+
+	for (;;)
+	{
+		while ( ! socket.canReadLine() )
+		{
+			if ( ! socket.waitForReadyRead( -1 ) )
+			{
+				std::cerr << "Lost the connection to the server." << std::endl;
+				return 1;
+			}
+		}
+
+		QString	reply( QString::fromUtf8( socket.readLine() ).trimmed() );
+		QString	what( reply.section( ' ', 0, 0 ) );
+
+		if ( what == "progress" )
+		{
+			progress.update( reply.section( ' ', 2, 2 ).toInt(), 100 );
+		}
+		else if ( what == "done" )
+		{
+			int			cut_count( reply.section( ' ', 2, 2 ).toInt() );
+			qint64	size( reply.section( ' ', 3, 3 ).toLongLong() );
+			QByteArray	gcode;
+
+			while ( gcode.size() < size )
+			{
+				if ( socket.bytesAvailable() == 0 && ! socket.waitForReadyRead( -1 ) )
+				{
+					std::cerr << "Lost the connection to the server." << std::endl;
+					return 1;
+				}
+				gcode += socket.read( size - gcode.size() );
+			}
+
+			QFile	file( output_filename );
+
+			if ( ! file.open( QIODevice::WriteOnly | QIODevice::Text ) || file.write( gcode ) != gcode.size() )
+			{
+				std::cerr << "Could not write " << output_filename.toLocal8Bit().constData() << "." << std::endl;
+				return 1;
+			}
+
+			std::cerr << cut_count << " cuts written to " << output_filename.toLocal8Bit().constData() << "." << std::endl;
+			return 0;
+		}
+		else if ( what == "failed" || what == "cancelled" || what == "error" )
+		{
+			std::cerr << reply.toLocal8Bit().constData() << std::endl;
+			return 2;
+		}
+	}
+}
+
+
 int main(int argc, char *argv[])
 {
 	QCoreApplication::setOrganizationName("WhirlingChair");
 	QCoreApplication::setOrganizationDomain("whirlingchair.com");
 	QCoreApplication::setApplicationName("CNC Halftone Wizard");
 
-	QApplication app(argc, argv);
+	bool	generate( false );
+	bool	verify( false );
+	bool	serve( false );
+	bool	submit( false );
+
+	for ( int i = 1; i < argc; ++i )
+	{
+		if ( QString( argv[i] ) == "--gcode" )
+			generate = true;
+		else if ( QString( argv[i] ) == "--verify" )
+			verify = true;
+		else if ( QString( argv[i] ) == "--serve" )
+			serve = true;
+		else if ( QString( argv[i] ) == "--submit" )
+			submit = true;
+	}
+
+	QApplication app(argc, argv, ! ( generate || verify || serve || submit ));
+
+	if ( generate )
+		return runHeadless( app.arguments() );
+	if ( verify )
+		return runVerify( app.arguments() );
+	if ( serve )
+		return runServer( app.arguments() );
+	if ( submit )
+		return runSubmit( app.arguments() );
+
 	HTCNCUI::MainWindow mainWindow;
 
 	qInstallMsgHandler(qtMessageHandler);
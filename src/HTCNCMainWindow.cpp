@@ -20,6 +20,7 @@
 
 
 #include <QUiLoader>
+#include <QCoreApplication>
 #include <QMessageBox>
 #include <QLabel>
 #include <QCloseEvent>
@@ -29,10 +30,23 @@
 #include <QTime>
 #include <QFileInfo>
 #include <QSettings>
+#include <QInputDialog>
+#include <QHeaderView>
+#include <QProgressBar>
+#include <QPushButton>
+#include <QStatusBar>
+#include <QThread>
 
 #include "HTCNCMainWindow.h"
 #include "HTCNCConsole.h"
+#include "HTCNCGCodeSimulator.h"
 #include "HTCNCHalftoner.h"
+#include "HTCNCImageLoader.h"
+#include "HTCNCImageView.h"
+#include "HTCNCJobCache.h"
+#include "HTCNCJobQueue.h"
+#include "HTCNCLattice.h"
+#include "HTCNCProgress.h"
 
 #include <assert.h>
 
@@ -43,9 +57,39 @@ using namespace HTCNC;
 namespace HTCNCUI
 {
 
+namespace
+{
+	// Shows the progress of a Halftoner run in the status bar.  It also
+	// keeps the window responsive during the run, so that the Cancel button
+	// can be pressed.
+	class WindowProgress : public Progress
+	{
+		public:
+			WindowProgress( QProgressBar* bar )
+				: m_bar( bar )
+			{
+			}
+
+		protected:
+			virtual void report( int percent )
+			{
+				m_bar->setValue( percent );
+				QCoreApplication::processEvents();
+			}
+
+		private:
+			QProgressBar*	m_bar;
+	};
+}
+
 
 MainWindow::MainWindow(QWidget *parent)
 : QMainWindow( parent )
+, m_applyingProfile( false )
+, m_jobQueue( new JobQueue( this ) )
+, m_progress( 0 )
+, m_generatingGCode( false )
+, m_recomputePending( false )
 {
 	m_ui.setupUi(this);
 
@@ -58,37 +102,41 @@ MainWindow::MainWindow(QWidget *parent)
 	
 	Console::Instance( Console::ALWAYS ) << tr("Greets from The CNC Halftone Wizard, version %1.\n").arg(VERSION_STR);
 
+	// Start from the defaults in the UI and override them with whatever
+	// was saved the last time the app was run.
 	QSettings	settings;
+	Profile		profile( currentProfile() );
+
+	profile.read( settings );
+	applyProfile( profile );
+
+	// The batch settings aren't part of a profile.
+	m_ui.m_outputDirLineEdit->setText( settings.value( "batch/output_dir" ).toString() );
+	m_ui.m_workerCountSpinBox->setValue( settings.value( "batch/workers", QThread::idealThreadCount() ).toInt() );
+	m_jobQueue->setOutputDirectory( m_ui.m_outputDirLineEdit->text() );
+	m_jobQueue->setMaxWorkers( m_ui.m_workerCountSpinBox->value() );
+	m_ui.m_jobTableWidget->horizontalHeader()->setStretchLastSection( true );
+	refreshJobProfiles();
 
-	if ( settings.contains( "halftone/source_pixel_step" ) )
-		m_ui.m_stepSpinBox->setValue( settings.value( "halftone/source_pixel_step" ).toInt() );
-	if ( settings.contains( "halftone/min_dot_gap" ) )
-		m_ui.m_minDotGapLineEdit->setText( settings.value( "halftone/min_dot_gap" ).toString() );
-	if ( settings.contains( "halftone/max_cut_depth_pct" ) )
-		m_ui.m_depthPercentageSpinBox->setValue( settings.value( "halftone/max_cut_depth_pct" ).toInt() );
-
-	if ( settings.contains( "g_code/preamble" ) )
-		m_ui.m_gcodePreambleTextEdit->setPlainText( settings.value( "g_code/preamble" ).toString() );
-
-	if ( settings.contains( "tool/feed" ) )
-		m_ui.m_feedLineEdit->setText( settings.value( "tool/feed" ).toString() );
-	if ( settings.contains( "tool/speed" ) )
-		m_ui.m_speedLineEdit->setText( settings.value( "tool/speed").toString() );
-	if ( settings.contains( "tool/fast_z" ) )
-		m_ui.m_fastZLineEdit->setText( settings.value( "tool/fast_z").toString() );
-	if ( settings.contains( "tool/coolant" ) )
-		m_ui.m_coolantCheckBox->setChecked( settings.value( "tool/coolant" ).toBool() );
-	if ( settings.contains( "tool/full_tool_depth" ) )
-		m_ui.m_toolDepthLineEdit->setText( settings.value( "tool/full_tool_depth" ).toString() );
-	if ( settings.contains( "tool/full_tool_width" ) )
-		m_ui.m_toolWidthLineEdit->setText( settings.value( "tool/full_tool_width" ).toString() );
-
-	m_outputImageLabel = new QLabel();
+	m_outputImageView = new ImageView();
 	m_sourceImageLabel = new QLabel();
 
-	m_ui.m_outputScrollArea->setWidget(m_outputImageLabel);
+	m_ui.m_outputScrollArea->setWidget(m_outputImageView);
 	m_ui.m_sourceScrollArea->setWidget(m_sourceImageLabel);
 
+	// The progress bar and Cancel button are only shown while halftoning.
+	m_progressBar = new QProgressBar();
+	m_progressBar->setRange( 0, 100 );
+	m_progressBar->hide();
+	m_cancelButton = new QPushButton( tr("Cancel") );
+	m_cancelButton->hide();
+	statusBar()->addPermanentWidget( m_progressBar );
+	statusBar()->addPermanentWidget( m_cancelButton );
+
+	connect(m_cancelButton,
+		SIGNAL(clicked()),
+		SLOT(onCancelButtonClicked()));
+
 	connect(m_ui.actionOpen,
 		SIGNAL(triggered()),
 		SLOT(onOpenActionTriggered()));
@@ -97,10 +145,74 @@ MainWindow::MainWindow(QWidget *parent)
 		SIGNAL(triggered()),
 		SLOT(onGenerateGCodeActionTriggered()));
 
+	connect(m_ui.actionVerifyGCode,
+		SIGNAL(triggered()),
+		SLOT(onVerifyGCodeActionTriggered()));
+
 	connect(m_ui.actionExit,
 		SIGNAL(triggered()),
 		SLOT(onExitActionTriggered()));
 
+	connect(m_ui.actionSaveProfile,
+		SIGNAL(triggered()),
+		SLOT(onSaveProfileActionTriggered()));
+
+	connect(m_ui.actionLoadProfile,
+		SIGNAL(triggered()),
+		SLOT(onLoadProfileActionTriggered()));
+
+	connect(m_ui.actionDeleteProfile,
+		SIGNAL(triggered()),
+		SLOT(onDeleteProfileActionTriggered()));
+
+	connect(m_ui.m_addJobsButton,
+		SIGNAL(clicked()),
+		SLOT(onAddJobsButtonClicked()));
+
+	connect(m_ui.m_addFolderButton,
+		SIGNAL(clicked()),
+		SLOT(onAddFolderButtonClicked()));
+
+	connect(m_ui.m_cancelJobButton,
+		SIGNAL(clicked()),
+		SLOT(onCancelJobButtonClicked()));
+
+	connect(m_ui.m_clearFinishedButton,
+		SIGNAL(clicked()),
+		SLOT(onClearFinishedButtonClicked()));
+
+	connect(m_ui.m_browseOutputDirToolButton,
+		SIGNAL(clicked()),
+		SLOT(onBrowseOutputDirButtonClicked()));
+
+	connect(m_ui.m_outputDirLineEdit,
+		SIGNAL(editingFinished()),
+		SLOT(onOutputDirChanged()));
+
+	connect(m_ui.m_workerCountSpinBox,
+		SIGNAL(valueChanged(int)),
+		SLOT(onWorkerCountChanged(int)));
+
+	// The job queue signals come from its worker threads, so these are
+	// queued connections.
+	connect(m_jobQueue,
+		SIGNAL(jobChanged(int)),
+		SLOT(onJobChanged(int)),
+		Qt::QueuedConnection);
+
+	connect(m_jobQueue,
+		SIGNAL(idle()),
+		SLOT(onJobQueueIdle()),
+		Qt::QueuedConnection);
+
+	connect(m_ui.m_addToolButton,
+		SIGNAL(clicked()),
+		SLOT(onAddToolButtonClicked()));
+
+	connect(m_ui.m_removeToolButton,
+		SIGNAL(clicked()),
+		SLOT(onRemoveToolButtonClicked()));
+
 	connect(m_ui.m_zoomPreviewSlider,
 				SIGNAL( valueChanged(int) ),
 				SLOT(recomputeOutput()));
@@ -117,6 +229,38 @@ MainWindow::MainWindow(QWidget *parent)
 				SIGNAL( valueChanged(int) ),
 				SLOT(recomputeOutput()));
 
+	connect(m_ui.m_depthLevelsSpinBox,
+				SIGNAL( valueChanged(int) ),
+				SLOT(recomputeOutput()));
+
+	connect(m_ui.m_gammaLineEdit,
+				SIGNAL( editingFinished() ),
+				SLOT(recomputeOutput()));
+
+	connect(m_ui.m_modulationComboBox,
+				SIGNAL( currentIndexChanged(int) ),
+				SLOT(recomputeOutput()));
+
+	connect(m_ui.m_latticeComboBox,
+				SIGNAL( currentIndexChanged(int) ),
+				SLOT(recomputeOutput()));
+
+	connect(m_ui.m_screenAngleSpinBox,
+				SIGNAL( valueChanged(int) ),
+				SLOT(recomputeOutput()));
+
+	connect(m_ui.m_outputWidthLineEdit,
+				SIGNAL( editingFinished() ),
+				SLOT(recomputeOutput()));
+
+	connect(m_ui.m_outputHeightLineEdit,
+				SIGNAL( editingFinished() ),
+				SLOT(recomputeOutput()));
+
+	connect(m_ui.m_dotPitchLineEdit,
+				SIGNAL( editingFinished() ),
+				SLOT(recomputeOutput()));
+
 	connect(m_ui.m_toolDepthLineEdit,
 				SIGNAL( editingFinished() ),
 				SLOT(recomputeOutput()));
@@ -159,6 +303,360 @@ void MainWindow::onExitActionTriggered()
 
 
 
+void MainWindow::onAddToolButtonClicked()
+{
+	int	row( m_ui.m_toolTableWidget->rowCount() );
+
+	// Default to the next tool number and the primary tool's geometry.
+	m_ui.m_toolTableWidget->insertRow( row );
+	m_ui.m_toolTableWidget->setItem( row, 0, new QTableWidgetItem( QString::number( row + 2 ) ) );
+	m_ui.m_toolTableWidget->setItem( row, 1, new QTableWidgetItem( m_ui.m_toolDepthLineEdit->text() ) );
+	m_ui.m_toolTableWidget->setItem( row, 2, new QTableWidgetItem( m_ui.m_toolWidthLineEdit->text() ) );
+	m_ui.m_toolTableWidget->setItem( row, 3, new QTableWidgetItem( "0" ) );
+}
+
+
+void MainWindow::onRemoveToolButtonClicked()
+{
+	int	row( m_ui.m_toolTableWidget->currentRow() );
+
+	if ( row >= 0 )
+		m_ui.m_toolTableWidget->removeRow( row );
+}
+
+
+void MainWindow::onSaveProfileActionTriggered()
+{
+	bool		ok( false );
+	QString	name( QInputDialog::getText( this,
+									tr("Save Profile"),
+									tr("Profile name:"),
+									QLineEdit::Normal,
+									m_profileName,
+									&ok ) ).trimmed();
+
+	if ( ! ok || name.isEmpty() )
+		return;
+
+	if ( ! ProfileStore::isValidName( name ) )
+	{
+		QMessageBox::warning( this, tr("Save Profile"), tr("Profile names may not contain slashes, colons or \"..\".") );
+		return;
+	}
+
+	ProfileStore	store;
+
+	if ( store.names().contains( name ) &&
+			 QMessageBox::No == QMessageBox::question( this, tr("Save Profile"),
+									tr("Replace the existing profile '%1'?").arg( name ),
+									QMessageBox::Yes | QMessageBox::No ) )
+	{
+		return;
+	}
+
+	if ( store.save( name, currentProfile() ) )
+	{
+		m_profileName = name;
+		refreshJobProfiles();
+		Console::Instance( Console::ALWAYS ) << tr("Saved profile '%1'.\n").arg( name );
+	}
+	else
+	{
+		Console::Instance( Console::FATAL ) << tr("Could not save profile '%1'.\n").arg( name );
+	}
+}
+
+
+void MainWindow::onLoadProfileActionTriggered()
+{
+	ProfileStore	store;
+	QStringList		names( store.names() );
+
+	if ( names.isEmpty() )
+	{
+		QMessageBox::information( this, tr("Load Profile"), tr("No profiles have been saved yet.") );
+		return;
+	}
+
+	bool		ok( false );
+	QString	name( QInputDialog::getItem( this,
+									tr("Load Profile"),
+									tr("Profile:"),
+									names,
+									qMax( 0, names.indexOf( m_profileName ) ),
+									false,
+									&ok ) );
+
+	if ( ! ok || name.isEmpty() )
+		return;
+
+	// Profiles only override the settings they contain.
+	Profile	profile( currentProfile() );
+
+	if ( store.load( name, profile ) )
+	{
+		m_profileName = name;
+		applyProfile( profile );
+		Console::Instance( Console::ALWAYS ) << tr("Loaded profile '%1'.\n").arg( name );
+		recomputeOutput();
+	}
+	else
+	{
+		Console::Instance( Console::FATAL ) << tr("Could not load profile '%1'.\n").arg( name );
+	}
+}
+
+
+void MainWindow::onDeleteProfileActionTriggered()
+{
+	ProfileStore	store;
+	QStringList		names( store.names() );
+
+	if ( names.isEmpty() )
+	{
+		QMessageBox::information( this, tr("Delete Profile"), tr("No profiles have been saved yet.") );
+		return;
+	}
+
+	bool		ok( false );
+	QString	name( QInputDialog::getItem( this,
+									tr("Delete Profile"),
+									tr("Profile:"),
+									names,
+									qMax( 0, names.indexOf( m_profileName ) ),
+									false,
+									&ok ) );
+
+	if ( ! ok || name.isEmpty() )
+		return;
+
+	if ( store.remove( name ) )
+	{
+		if ( name == m_profileName )
+			m_profileName.clear();
+		refreshJobProfiles();
+		Console::Instance( Console::ALWAYS ) << tr("Deleted profile '%1'.\n").arg( name );
+	}
+}
+
+
+void MainWindow::refreshJobProfiles()
+{
+	QString	selected( m_ui.m_jobProfileComboBox->currentText() );
+
+	// The first entry is always the current settings.
+	while ( m_ui.m_jobProfileComboBox->count() > 1 )
+		m_ui.m_jobProfileComboBox->removeItem( 1 );
+
+	m_ui.m_jobProfileComboBox->addItems( ProfileStore().names() );
+	m_ui.m_jobProfileComboBox->setCurrentIndex( qMax( 0, m_ui.m_jobProfileComboBox->findText( selected ) ) );
+}
+
+
+void MainWindow::enqueueJobs( const QStringList& filenames )
+{
+	Profile	profile( currentProfile() );
+	QString	profile_name( m_profileName );
+
+	if ( m_ui.m_jobProfileComboBox->currentIndex() > 0 )
+	{
+		// Profiles only override the settings they contain.
+		profile_name = m_ui.m_jobProfileComboBox->currentText();
+		if ( ! ProfileStore().load( profile_name, profile ) )
+		{
+			Console::Instance( Console::FATAL ) << tr("Could not load profile '%1'.\n").arg( profile_name );
+			return;
+		}
+	}
+
+	int	priority( m_ui.m_jobPrioritySpinBox->value() );
+
+	for ( int i = 0; i < filenames.size(); ++i )
+	{
+		int	row( m_ui.m_jobTableWidget->rowCount() );
+		QTableWidgetItem*	source_item( new QTableWidgetItem( QFileInfo( filenames[i] ).fileName() ) );
+		QProgressBar*			progress( new QProgressBar() );
+
+		// Add the row before the job, since the job may report back right away.
+		m_ui.m_jobTableWidget->insertRow( row );
+		source_item->setToolTip( filenames[i] );
+		m_ui.m_jobTableWidget->setItem( row, 0, source_item );
+		m_ui.m_jobTableWidget->setItem( row, 1, new QTableWidgetItem( profile_name.isEmpty() ? tr("Current Settings") : profile_name ) );
+		m_ui.m_jobTableWidget->setItem( row, 2, new QTableWidgetItem( QString::number( priority ) ) );
+		m_ui.m_jobTableWidget->setItem( row, 3, new QTableWidgetItem( tr("Queued") ) );
+		progress->setRange( 0, 100 );
+		progress->setValue( 0 );
+		m_ui.m_jobTableWidget->setCellWidget( row, 4, progress );
+
+		source_item->setData( Qt::UserRole, m_jobQueue->enqueue( filenames[i], profile_name, profile, priority ) );
+	}
+
+	Console::Instance( Console::ALWAYS ) << tr("Added %1 job(s) to the batch queue.\n").arg( filenames.size() );
+}
+
+
+int MainWindow::jobRow( int id ) const
+{
+	for ( int row = 0; row < m_ui.m_jobTableWidget->rowCount(); ++row )
+	{
+		QTableWidgetItem*	item( m_ui.m_jobTableWidget->item( row, 0 ) );
+
+		if ( item && item->data( Qt::UserRole ).toInt() == id )
+			return row;
+	}
+	return -1;
+}
+
+
+void MainWindow::onAddJobsButtonClicked()
+{
+	QStringList	filenames( QFileDialog::getOpenFileNames( this,
+									tr("Choose images to add to the queue"),
+									QString(), 	// Starting dir
+									tr("Images (*.png *.gif *.jpg)") ) );
+
+	if ( ! filenames.isEmpty() )
+		enqueueJobs( filenames );
+}
+
+
+void MainWindow::onAddFolderButtonClicked()
+{
+	QSettings	settings;
+	QString		dirname( QFileDialog::getExistingDirectory( this,
+									tr("Choose a folder of images to add to the queue"),
+									settings.value( "batch/source_dir" ).toString() ) );
+
+	if ( dirname.isEmpty() )
+		return;
+
+	settings.setValue( "batch/source_dir", dirname );
+
+	QDir				dir( dirname );
+	QStringList	filters;
+	QStringList	filenames;
+
+	filters << "*.png" << "*.gif" << "*.jpg";
+
+	QStringList	entries( dir.entryList( filters, QDir::Files, QDir::Name ) );
+
+	for ( int i = 0; i < entries.size(); ++i )
+		filenames << dir.absoluteFilePath( entries[i] );
+
+	if ( filenames.isEmpty() )
+	{
+		Console::Instance( Console::WARN ) << tr("There are no images in %1.\n").arg( dirname );
+		return;
+	}
+
+	enqueueJobs( filenames );
+}
+
+
+void MainWindow::onCancelJobButtonClicked()
+{
+	QList<QTableWidgetItem*>	selected( m_ui.m_jobTableWidget->selectedItems() );
+
+	for ( int i = 0; i < selected.size(); ++i )
+	{
+		if ( selected[i]->column() == 0 )
+			m_jobQueue->cancel( selected[i]->data( Qt::UserRole ).toInt() );
+	}
+}
+
+
+void MainWindow::onClearFinishedButtonClicked()
+{
+	for ( int row = m_ui.m_jobTableWidget->rowCount() - 1; row >= 0; --row )
+	{
+		if ( m_jobQueue->remove( m_ui.m_jobTableWidget->item( row, 0 )->data( Qt::UserRole ).toInt() ) )
+			m_ui.m_jobTableWidget->removeRow( row );
+	}
+}
+
+
+void MainWindow::onBrowseOutputDirButtonClicked()
+{
+	QString	dirname( QFileDialog::getExistingDirectory( this,
+									tr("Choose the folder to write g code to"),
+									m_ui.m_outputDirLineEdit->text() ) );
+
+	if ( ! dirname.isEmpty() )
+	{
+		m_ui.m_outputDirLineEdit->setText( dirname );
+		onOutputDirChanged();
+	}
+}
+
+
+void MainWindow::onOutputDirChanged()
+{
+	m_jobQueue->setOutputDirectory( m_ui.m_outputDirLineEdit->text().trimmed() );
+}
+
+
+void MainWindow::onWorkerCountChanged( int count )
+{
+	m_jobQueue->setMaxWorkers( count );
+}
+
+
+void MainWindow::onJobChanged( int id )
+{
+	int	row( jobRow( id ) );
+
+	if ( row < 0 )
+		return;
+
+	JobQueue::Job	job( m_jobQueue->getJob( id ) );
+	QString	status;
+
+	switch ( job.m_state )
+	{
+		case JobQueue::QUEUED:
+			status = tr("Queued");
+			break;
+		case JobQueue::RUNNING:
+			status = tr("Running");
+			break;
+		case JobQueue::DONE:
+			status = job.m_fromCache ? tr("Done (cached)") : tr("Done");
+			break;
+		case JobQueue::FAILED:
+			status = tr("Failed");
+			break;
+		case JobQueue::CANCELLED:
+			status = tr("Cancelled");
+			break;
+	}
+
+	QTableWidgetItem*	status_item( m_ui.m_jobTableWidget->item( row, 3 ) );
+
+	if ( status_item->text() != status )
+	{
+		// Only log each change of state once.
+		if ( job.m_state == JobQueue::DONE )
+			Console::Instance( Console::ALWAYS ) << tr("G code written to %1 (%2 cuts).\n").arg( job.m_outputFilename ).arg( job.m_cutCount );
+		else if ( job.m_state == JobQueue::FAILED )
+			Console::Instance( Console::FATAL ) << job.m_message << "\n";
+	}
+
+	status_item->setText( status );
+	status_item->setToolTip( job.m_state == JobQueue::DONE ? job.m_outputFilename : job.m_message );
+
+	QProgressBar*	progress( qobject_cast<QProgressBar*>( m_ui.m_jobTableWidget->cellWidget( row, 4 ) ) );
+
+	if ( progress )
+		progress->setValue( job.m_progress );
+}
+
+
+void MainWindow::onJobQueueIdle()
+{
+	Console::Instance( Console::ALWAYS ) << tr("All batch jobs have finished.\n");
+}
+
+
 void MainWindow::onOpenActionTriggered()
 {
 	QString	filename;
@@ -166,11 +664,12 @@ void MainWindow::onOpenActionTriggered()
 	filename = QFileDialog::getOpenFileName( this, 
 									tr("Choose a source image"), 
 									QString(), 	// Starting dir
-									tr("Images (*.png *.gif *.jpg)") );
+									tr("Images (*.png *.gif *.jpg *.jpeg *.bmp *.tif *.tiff *.pgm)") );
 
 	if ( ! filename.isEmpty() )
 	{
 		m_sourceFilename = filename;
+		m_sourceImageLabel->setPixmap( QPixmap( filename ) );
 
 		recomputeOutput();
 	}
@@ -184,6 +683,12 @@ void MainWindow::onGenerateGCodeActionTriggered()
 		return;
 	}
 
+	if ( m_progress )
+	{
+		Console::Instance( Console::WARN ) << tr("Please wait for the preview to finish (or cancel it) before generating g code.\n");
+		return;
+	}
+
 	QString	filename(m_gCodeFilename);
 
 	if ( m_gCodeFilename.isEmpty() )
@@ -203,6 +708,71 @@ void MainWindow::onGenerateGCodeActionTriggered()
 		m_gCodeFilename = filename;
 
 		regenerate(true, m_gCodeFilename);
+
+		// Catch up with any changes made while the g code was generated.
+		if ( m_recomputePending )
+			recomputeOutput();
+	}
+}
+
+
+
+void MainWindow::onVerifyGCodeActionTriggered()
+{
+	if ( m_progress )
+	{
+		Console::Instance( Console::WARN ) << tr("Please wait for the preview to finish (or cancel it) before verifying g code.\n");
+		return;
+	}
+
+	QString	filename( QFileDialog::getOpenFileName( this,
+									tr("Choose a g code file to verify"),
+									m_gCodeFilename,
+									tr("G Code (*.ngc)") ) );
+
+	if ( filename.isEmpty() )
+		return;
+
+	QFile	file( filename );
+
+	if ( ! file.open( QIODevice::ReadOnly ) )
+	{
+		Console::Instance( Console::FATAL ) << tr("Could not open %1 for reading.\n").arg(filename);
+		return;
+	}
+
+	// The cuts are sized using the tools in the current settings.
+	GCodeSimulator	simulator( currentProfile().m_params );
+	WindowProgress	progress( m_progressBar );
+
+	showProgress( &progress, false );
+
+	bool	passed( simulator.run( file, &progress ) );
+
+	hideProgress();
+
+	if ( simulator.wasCancelled() )
+	{
+		Console::Instance( Console::ALWAYS ) << tr("Verification cancelled.\n");
+		return;
+	}
+
+	Console::Instance( Console::ALWAYS ) << tr("Verification of %1:\n").arg(filename) << simulator.getSummary();
+
+	// Show what the g code will cut in place of the preview.
+	QImage	cut_image( simulator.render( 1000 ) );
+
+	if ( ! cut_image.isNull() )
+		m_outputImageView->setImage( cut_image );
+
+	if ( passed )
+	{
+		Console::Instance( Console::ALWAYS ) << tr("%1 passed verification.\n").arg(filename);
+	}
+	else
+	{
+		QMessageBox::warning( this, tr("Verify G Code"),
+									tr("%1 has %2 error(s).  See the log for details.").arg( filename ).arg( simulator.getErrorCount() ) );
 	}
 }
 
@@ -210,6 +780,15 @@ void MainWindow::onGenerateGCodeActionTriggered()
 
 void MainWindow::closeEvent( QCloseEvent* event )
 {
+	if ( ! m_jobQueue->isIdle() &&
+			 QMessageBox::No == QMessageBox::question( this, tr("Batch jobs running"),
+									tr("Some batch jobs haven't finished yet.\nDo you wish to cancel them and exit?"),
+									QMessageBox::Yes | QMessageBox::No ) )
+	{
+		event->ignore();
+		return;
+	}
+
 	// Copy the log to a file in the starting directory.
 	QString	logFilename( "/CNCHalftonerLog_" );
 	
@@ -237,115 +816,316 @@ void MainWindow::closeEvent( QCloseEvent* event )
 	// Update our settings
 	QSettings	settings;
 
-	settings.setValue( "halftone/source_pixel_step", m_ui.m_stepSpinBox->value() );
-	settings.setValue( "halftone/min_dot_gap", m_ui.m_minDotGapLineEdit->text().toDouble() );
-	settings.setValue( "halftone/max_cut_depth_pct", m_ui.m_depthPercentageSpinBox->value() );
+	currentProfile().write( settings );
+	settings.setValue( "batch/output_dir", m_ui.m_outputDirLineEdit->text() );
+	settings.setValue( "batch/workers", m_ui.m_workerCountSpinBox->value() );
 
-	settings.setValue( "g_code/preamble", m_ui.m_gcodePreambleTextEdit->toPlainText() );
-
-	settings.setValue( "tool/feed", m_ui.m_feedLineEdit->text().toDouble() );
-	settings.setValue( "tool/speed", m_ui.m_speedLineEdit->text().toDouble() );
-	settings.setValue( "tool/fast_z", m_ui.m_fastZLineEdit->text().toDouble() );
-	settings.setValue( "tool/coolant", m_ui.m_coolantCheckBox->isChecked());
-	settings.setValue( "tool/full_tool_depth", m_ui.m_toolDepthLineEdit->text().toDouble() );
-	settings.setValue( "tool/full_tool_width", m_ui.m_toolWidthLineEdit->text().toDouble() );
+	m_jobQueue->cancelAll();
+	if ( m_progress )
+		m_progress->cancel();
 
 	event->accept();
 }
 
 
+QString MainWindow::toolTableValue( int row, int column ) const
+{
+	QTableWidgetItem*	item( m_ui.m_toolTableWidget->item( row, column ) );
+
+	return item ? item->text() : QString();
+}
+
+
 void MainWindow::recomputeOutput()
 {
-	if ( m_sourceFilename.isEmpty() )
+	if ( m_sourceFilename.isEmpty() || m_applyingProfile )
 		return;
-	regenerate(false);
+
+	if ( m_progress )
+	{
+		// Something changed while a run is keeping the window responsive.
+		// An out of date preview can be abandoned, but g code generation
+		// is left to finish.  Either way, the preview is recomputed once the
+		// run is over.
+		m_recomputePending = true;
+		if ( ! m_generatingGCode )
+			m_progress->cancel();
+		return;
+	}
+
+	do
+	{
+		m_recomputePending = false;
+		regenerate(false);
+	} while ( m_recomputePending );
+}
+
+
+void MainWindow::showProgress( Progress* progress, bool generatingGCode )
+{
+	m_progress = progress;
+	m_generatingGCode = generatingGCode;
+	m_progressBar->setValue( 0 );
+	m_progressBar->show();
+	m_cancelButton->show();
+}
+
+
+void MainWindow::hideProgress()
+{
+	m_progress = 0;
+	m_generatingGCode = false;
+	m_progressBar->hide();
+	m_cancelButton->hide();
+}
+
+
+void MainWindow::onCancelButtonClicked()
+{
+	if ( m_progress )
+		m_progress->cancel();
+}
+
+
+
+Profile MainWindow::currentProfile() const
+{
+	Profile	profile;
+	Halftoner::CNCParameters&	params( profile.m_params );
+
+	params.m_step = m_ui.m_stepSpinBox->value();
+	params.m_fullToolDepth = m_ui.m_toolDepthLineEdit->text().toDouble();
+	params.m_fullToolWidth = m_ui.m_toolWidthLineEdit->text().toDouble();
+	params.m_maxCutPercent = m_ui.m_depthPercentageSpinBox->value() / 100.0;
+	params.m_minDotGap = m_ui.m_minDotGapLineEdit->text().toDouble();
+	params.m_fastZ = m_ui.m_fastZLineEdit->text().toDouble();
+	params.m_peckDepth = m_ui.m_peckDepthLineEdit->text().toDouble();
+	params.m_minimizeTravel = m_ui.m_minimizeTravelCheckBox->isChecked();
+	params.m_depthLevels = m_ui.m_depthLevelsSpinBox->value();
+	params.m_gamma = m_ui.m_gammaLineEdit->text().toDouble();
+	params.m_modulation = static_cast<Halftoner::Modulation>( m_ui.m_modulationComboBox->currentIndex() );
+	params.m_lattice = static_cast<Halftoner::LatticeType>( m_ui.m_latticeComboBox->currentIndex() );
+	params.m_screenAngle = m_ui.m_screenAngleSpinBox->value();
+	params.m_outputWidth = m_ui.m_outputWidthLineEdit->text().toDouble();
+	params.m_outputHeight = m_ui.m_outputHeightLineEdit->text().toDouble();
+	params.m_dotPitch = m_ui.m_dotPitchLineEdit->text().toDouble();
+	params.m_travelLimits.m_minX = m_ui.m_travelMinXLineEdit->text().toDouble();
+	params.m_travelLimits.m_maxX = m_ui.m_travelMaxXLineEdit->text().toDouble();
+	params.m_travelLimits.m_minY = m_ui.m_travelMinYLineEdit->text().toDouble();
+	params.m_travelLimits.m_maxY = m_ui.m_travelMaxYLineEdit->text().toDouble();
+	params.m_travelLimits.m_minZ = m_ui.m_travelMinZLineEdit->text().toDouble();
+	params.m_travelLimits.m_maxZ = m_ui.m_travelMaxZLineEdit->text().toDouble();
+
+	for ( int i = 0; i < m_ui.m_toolTableWidget->rowCount(); ++i )
+	{
+		Halftoner::Tool	tool;
+
+		tool.m_number = toolTableValue( i, 0 ).toInt();
+		tool.m_fullToolDepth = toolTableValue( i, 1 ).toDouble();
+		tool.m_fullToolWidth = toolTableValue( i, 2 ).toDouble();
+		tool.m_peckDepth = toolTableValue( i, 3 ).toDouble();
+		params.m_tools.push_back( tool );
+	}
+
+	profile.m_feed = m_ui.m_feedLineEdit->text().toDouble();
+	profile.m_speed = m_ui.m_speedLineEdit->text().toDouble();
+	profile.m_coolant = m_ui.m_coolantCheckBox->isChecked();
+	profile.m_preamble = m_ui.m_gcodePreambleTextEdit->toPlainText();
+
+	return profile;
+}
+
+
+void MainWindow::applyProfile( const Profile& profile )
+{
+	const Halftoner::CNCParameters&	params( profile.m_params );
+
+	// Don't recompute the preview for every widget that changes.
+	m_applyingProfile = true;
+
+	m_ui.m_stepSpinBox->setValue( params.m_step );
+	m_ui.m_minDotGapLineEdit->setText( QString::number( params.m_minDotGap ) );
+	m_ui.m_depthPercentageSpinBox->setValue( int( params.m_maxCutPercent * 100 + 0.5 ) );
+	m_ui.m_depthLevelsSpinBox->setValue( params.m_depthLevels );
+	m_ui.m_gammaLineEdit->setText( QString::number( params.m_gamma ) );
+	m_ui.m_modulationComboBox->setCurrentIndex( params.m_modulation );
+	m_ui.m_latticeComboBox->setCurrentIndex( params.m_lattice );
+	m_ui.m_screenAngleSpinBox->setValue( int( params.m_screenAngle ) );
+	m_ui.m_outputWidthLineEdit->setText( QString::number( params.m_outputWidth ) );
+	m_ui.m_outputHeightLineEdit->setText( QString::number( params.m_outputHeight ) );
+	m_ui.m_dotPitchLineEdit->setText( QString::number( params.m_dotPitch ) );
+
+	m_ui.m_gcodePreambleTextEdit->setPlainText( profile.m_preamble );
+	m_ui.m_minimizeTravelCheckBox->setChecked( params.m_minimizeTravel );
+	m_ui.m_travelMinXLineEdit->setText( QString::number( params.m_travelLimits.m_minX ) );
+	m_ui.m_travelMaxXLineEdit->setText( QString::number( params.m_travelLimits.m_maxX ) );
+	m_ui.m_travelMinYLineEdit->setText( QString::number( params.m_travelLimits.m_minY ) );
+	m_ui.m_travelMaxYLineEdit->setText( QString::number( params.m_travelLimits.m_maxY ) );
+	m_ui.m_travelMinZLineEdit->setText( QString::number( params.m_travelLimits.m_minZ ) );
+	m_ui.m_travelMaxZLineEdit->setText( QString::number( params.m_travelLimits.m_maxZ ) );
+
+	m_ui.m_feedLineEdit->setText( QString::number( profile.m_feed ) );
+	m_ui.m_speedLineEdit->setText( QString::number( profile.m_speed ) );
+	m_ui.m_fastZLineEdit->setText( QString::number( params.m_fastZ ) );
+	m_ui.m_coolantCheckBox->setChecked( profile.m_coolant );
+	m_ui.m_toolDepthLineEdit->setText( QString::number( params.m_fullToolDepth ) );
+	m_ui.m_toolWidthLineEdit->setText( QString::number( params.m_fullToolWidth ) );
+	m_ui.m_peckDepthLineEdit->setText( QString::number( params.m_peckDepth ) );
+
+	m_ui.m_toolTableWidget->setRowCount( 0 );
+	for ( size_t i = 0; i < params.m_tools.size(); ++i )
+	{
+		const Halftoner::Tool&	tool( params.m_tools[i] );
+		int	row( static_cast<int>( i ) );
+
+		m_ui.m_toolTableWidget->insertRow( row );
+		m_ui.m_toolTableWidget->setItem( row, 0, new QTableWidgetItem( QString::number( tool.m_number ) ) );
+		m_ui.m_toolTableWidget->setItem( row, 1, new QTableWidgetItem( QString::number( tool.m_fullToolDepth ) ) );
+		m_ui.m_toolTableWidget->setItem( row, 2, new QTableWidgetItem( QString::number( tool.m_fullToolWidth ) ) );
+		m_ui.m_toolTableWidget->setItem( row, 3, new QTableWidgetItem( QString::number( tool.m_peckDepth ) ) );
+	}
+
+	m_applyingProfile = false;
 }
 
+
 void MainWindow::regenerate( bool generateGCode, const QString& filename )
 {
 	int	scale_factor( m_ui.m_zoomPreviewSlider->value() );
-	int	step( m_ui.m_stepSpinBox->value() );
-	int depth_percentage( m_ui.m_depthPercentageSpinBox->value() );
-	double tool_width( m_ui.m_toolWidthLineEdit->text().toDouble() );
-	double tool_depth( m_ui.m_toolDepthLineEdit->text().toDouble() );
-	double min_dot_gap( m_ui.m_minDotGapLineEdit->text().toDouble() );
-	double fastZ( m_ui.m_fastZLineEdit->text().toDouble() );
-	double max_dot_size( tool_width * depth_percentage / 100 );
-
-	QPixmap	src_pm( m_sourceFilename );
-	QImage	dst_img( src_pm.width()*scale_factor, src_pm.height()*scale_factor, QImage::Format_RGB32 );
-	Halftoner::CNCParameters	params;
-
-	params.m_step = step;
-	params.m_fullToolDepth = tool_depth;
-	params.m_fullToolWidth = tool_width;
-	params.m_maxCutPercent = depth_percentage / 100.0;
-	params.m_minDotGap = min_dot_gap;
-	params.m_fastZ = fastZ;
-
-	Halftoner	ht( src_pm, dst_img, scale_factor, generateGCode, params );
+	Profile	profile( currentProfile() );
+	const Halftoner::CNCParameters&	params( profile.m_params );
+	QStringList	param_errors( Lattice::checkParameters( params ) );
+	JobCache		cache;
+	QByteArray	source_hash;
+	QByteArray	job_key;
+
+	if ( generateGCode && ! param_errors.isEmpty() )
+	{
+		for ( int i = 0; i < param_errors.size(); ++i )
+			Console::Instance( Console::FATAL ) << param_errors[i] << "\n";
+		QMessageBox::warning( this, tr("Generate G Code"),
+									tr("The settings can't be cut as they are, so %1 was not written.  See the log for details.").arg( filename ) );
+		return;
+	}
+
+	if ( generateGCode )
+	{
+		// If this exact image has already been run with this exact profile,
+		// the g code can come straight from the cache.  (The preview is
+		// already up to date, since it is recomputed whenever a parameter
+		// changes.)
+		QByteArray	cached_gcode;
+		int					cached_cuts;
+
+		source_hash = JobCache::hashFile( m_sourceFilename );
+		job_key = JobCache::makeKey( source_hash, profile );
+		if ( ! source_hash.isEmpty() && cache.lookup( job_key, cached_gcode, cached_cuts ) )
+		{
+			Console::Instance( Console::ALWAYS ) << tr("Using cached g code from an earlier identical job.\n");
+			writeGCodeFile( filename, profile, cached_gcode );
+			return;
+		}
+	}
+
+	// The source is decoded no larger than the settings need; the preview
+	// is still drawn at the full size.
+	ImageLoader	loader( m_sourceFilename );
+	Halftoner::CNCParameters	job_params( params );
+	int			reduction;
+	QImage	src_img( loader.loadForJob( job_params, &reduction ) );
+
+	if ( src_img.isNull() )
+	{
+		Console::Instance( Console::FATAL ) << tr("Could not read %1.\n").arg( m_sourceFilename );
+		return;
+	}
+
+	QSize		src_size( loader.getSize().isValid() ? loader.getSize() : src_img.size() * reduction );
+	// The preview only ever has black, white and grey in it.
+	QImage	dst_img( src_size.width()*scale_factor, src_size.height()*scale_factor, QImage::Format_Indexed8 );
+
+	dst_img.setColorTable( ImageLoader::greyTable() );
+
+	WindowProgress	progress( m_progressBar );
+
+	showProgress( &progress, generateGCode );
+
+	Halftoner	ht( src_img, dst_img, scale_factor * reduction, generateGCode, job_params, &progress );
+
+	hideProgress();
+
+	if ( ht.wasCancelled() )
+	{
+		if ( generateGCode )
+			Console::Instance( Console::ALWAYS ) << tr("G code generation cancelled.\n");
+		return;
+	}
 
 	int	cut_count( ht.getCutCount() );
 
-	m_sourceImageLabel->setPixmap( src_pm );
-	m_outputImageLabel->setPixmap( QPixmap::fromImage(dst_img));
+	m_outputImageView->setImage( dst_img );
 
-	m_ui.m_outputWidthLabel->setText( QString::number(src_pm.width() * ( max_dot_size + min_dot_gap ) / step));
-	m_ui.m_outputHeightLabel->setText( QString::number(src_pm.height() * ( max_dot_size + min_dot_gap ) / step));
+	double	output_width, output_height;
+
+	Lattice::getOutputSize( params, src_size.width(), src_size.height(), output_width, output_height );
+	m_ui.m_outputWidthLabel->setText( QString::number( output_width ) );
+	m_ui.m_outputHeightLabel->setText( QString::number( output_height ) );
+	// The preview is still drawn, so the problem can be seen.
+	for ( int i = 0; i < param_errors.size(); ++i )
+		Console::Instance( Console::WARN ) << param_errors[i] << "\n";
 	m_ui.m_outputCutsLabel->setText( tr("%1, requiring %2 minutes at 1 second/cut")
 									.arg(QString::number(cut_count))
 									.arg(QString::number(cut_count/60.0)) );
 
 	if ( generateGCode )
 	{
-		QFile	file( filename );
+		const Halftoner::MoveStatistics&	stats( ht.getMoveStatistics() );
 
-		// TODO: Consider getting rid of Text flag.  It causes all line feeds
-		// to be replaced with carriage return + line feed under Windows, which
-		// is kind of an anachronism and makes the output file less portable
-		// (since some linux apps still get heartburn from the CR+LF combo).
-		if ( file.open( QIODevice::WriteOnly | QIODevice::Text ) )
+		if ( stats.m_rapidCount > 0 )
 		{
-			// Write the preamble
-			QString	preamble( "(" + tr("Generated by the CNC Halftone Wizard.") + ")\n" );
-
-			preamble += "(";
-			preamble += tr("Generated at ");
-			preamble += QDateTime::currentDateTime().toString( tr("HH:mm:ss dd MMM yyyy") );
-			preamble += ")\n";
-			preamble += m_ui.m_gcodePreambleTextEdit->toPlainText();
-			preamble += "\n";
-			preamble += "F" + QString::number(m_ui.m_feedLineEdit->text().toDouble());
-			preamble += "\n";
-			preamble += "S" + QString::number(m_ui.m_speedLineEdit->text().toDouble());
-			preamble += "\n";
-
-			if ( m_ui.m_coolantCheckBox->isChecked() )
-				preamble += "M08\n";
-
-			file.write( preamble.toAscii() );
-			file.write( ht.getGCode().toAscii() );
-
-			QString	postamble;
-			if ( m_ui.m_coolantCheckBox->isChecked() )
-				postamble += "M09\n";
-			postamble += "M30\n";
-
-			file.write( postamble.toAscii() );
-			file.close();
-
-			Console::Instance( Console::ALWAYS ) << tr("G code written to %1.\n").arg(filename);
+			Console::Instance( Console::ALWAYS ) << tr("The tool moves over X %1 to %2, Y %3 to %4 and Z %5 to %6, with %7 feed moves and %8 of rapid moves.\n")
+										.arg( stats.m_minX ).arg( stats.m_maxX )
+										.arg( stats.m_minY ).arg( stats.m_maxY )
+										.arg( stats.m_minZ ).arg( stats.m_maxZ )
+										.arg( stats.m_feedCount ).arg( stats.m_rapidDistance );
+		}
+
+		// Nothing is written (or cached) for a job that would run the
+		// machine into its limits.
+		if ( ! ht.getTravelErrors().isEmpty() )
+		{
+			for ( int i = 0; i < ht.getTravelErrors().size(); ++i )
+				Console::Instance( Console::FATAL ) << ht.getTravelErrors()[i] << "\n";
+			QMessageBox::warning( this, tr("Generate G Code"),
+										tr("The g code would move the tool outside the machine's travel, so %1 was not written.  See the log for details.").arg( filename ) );
+			return;
 		}
-		else
+
+		QByteArray	gcode( ht.getGCode().toAscii() );
+
+		if ( ! source_hash.isEmpty() &&
+				 ! cache.store( job_key, source_hash, m_profileName, profile, gcode, cut_count ) )
 		{
-			Console::Instance( Console::FATAL ) << tr("Could not open %1 for writing.\n").arg(filename);
+			Console::Instance( Console::WARN ) << tr("Could not add the job to the cache.\n");
 		}
+		writeGCodeFile( filename, profile, gcode );
 	}
 }
 
 
+void MainWindow::writeGCodeFile( const QString& filename, const Profile& profile, const QByteArray& gCode )
+{
+	if ( profile.writeGCodeFile( filename, gCode ) )
+	{
+		Console::Instance( Console::ALWAYS ) << tr("G code written to %1.\n").arg(filename);
+	}
+	else
+	{
+		Console::Instance( Console::FATAL ) << tr("Could not open %1 for writing.\n").arg(filename);
+	}
+}
 
 
-}; // Namespace HTCNCUI
 
 
+}; // Namespace HTCNCUI
@@ -20,6 +20,7 @@
 #define HTCNCMAINWINDOW_H
 
 #include "ui_MainWindow.h"
+#include "HTCNCProfile.h"
 
 #include <QDir>
 #include <QFileInfo>
@@ -28,11 +29,20 @@
 
 // Forward declarations
 class QLabel;
+class QProgressBar;
+class QPushButton;
 class QShortcut;
 
+namespace HTCNC
+{
+	class JobQueue;
+	class Progress;
+}
+
 
 namespace HTCNCUI
 {
+	class ImageView;
 
 
 /**@brief The main application window. */
@@ -60,8 +70,40 @@ private slots:
 	void onOpenActionTriggered();
 	/// Responds to File->Generate G Code
 	void onGenerateGCodeActionTriggered();
+	/// Responds to File->Verify G Code
+	void onVerifyGCodeActionTriggered();
 	/// Responds to the user requesting to exit the app.
 	void onExitActionTriggered();
+	/// Adds a row to the additional tools table.
+	void onAddToolButtonClicked();
+	/// Removes the selected row from the additional tools table.
+	void onRemoveToolButtonClicked();
+	/// Responds to Profile->Save Profile
+	void onSaveProfileActionTriggered();
+	/// Responds to Profile->Load Profile
+	void onLoadProfileActionTriggered();
+	/// Responds to Profile->Delete Profile
+	void onDeleteProfileActionTriggered();
+	/// Adds the chosen images to the batch queue.
+	void onAddJobsButtonClicked();
+	/// Adds every image in the chosen folder to the batch queue.
+	void onAddFolderButtonClicked();
+	/// Cancels the selected batch jobs.
+	void onCancelJobButtonClicked();
+	/// Removes the batch jobs that are no longer queued or running.
+	void onClearFinishedButtonClicked();
+	/// Lets the user pick the batch output folder.
+	void onBrowseOutputDirButtonClicked();
+	/// Updates the batch output folder.
+	void onOutputDirChanged();
+	/// Updates the number of batch workers.
+	void onWorkerCountChanged( int count );
+	/// Updates a batch job's row in the job table.
+	void onJobChanged( int id );
+	/// Reports that the batch queue has run dry.
+	void onJobQueueIdle();
+	/// Cancels the halftoning that is in progress.
+	void onCancelButtonClicked();
 
 	/// Responds to requests to see the application's "about" info.
 	//void onAboutActionTriggered();
@@ -78,14 +120,57 @@ private:
 
 	void regenerate( bool generateGCode, const QString& filename = QString() );
 
+	/// Writes a complete g code file (pre/post-amble included) for the given
+	/// profile and g code body.
+	void writeGCodeFile( const QString& filename, const HTCNC::Profile& profile, const QByteArray& gCode );
+
+	/// Gathers the current contents of the UI into a profile.
+	HTCNC::Profile currentProfile() const;
+	/// Sets the UI to match the given profile.
+	void applyProfile( const HTCNC::Profile& profile );
+
+	/// Shows the progress bar and Cancel button for the given run.
+	void showProgress( HTCNC::Progress* progress, bool generatingGCode );
+	/// Hides the progress bar and Cancel button once a run is over.
+	void hideProgress();
+
+	/// Refills the batch profile list from the profile store.
+	void refreshJobProfiles();
+	/// Adds the given images to the batch queue with the selected profile
+	/// and priority.
+	void enqueueJobs( const QStringList& filenames );
+	/// Returns the job table row of a batch job, or -1.
+	int jobRow( int id ) const;
+
+	/// Returns the text in the given cell of the additional tools table.
+	QString toolTableValue( int row, int column ) const;
+
 	/// The Designer-generated user interface object.
 	Ui::MainWindow		m_ui;
 
 	QLabel*						m_sourceImageLabel;
-	QLabel*						m_outputImageLabel;
+	ImageView*				m_outputImageView;
 
 	QString						m_sourceFilename;
 	QString						m_gCodeFilename;
+	/// The name of the last profile saved or loaded (empty if none).
+	QString						m_profileName;
+	/// True while applyProfile() is changing the UI.
+	bool							m_applyingProfile;
+
+	/// Runs the batch jobs.
+	HTCNC::JobQueue*	m_jobQueue;
+
+	/// Shows the progress of the halftoning in the status bar.
+	QProgressBar*			m_progressBar;
+	/// Cancels the halftoning.
+	QPushButton*			m_cancelButton;
+	/// The progress of the halftoning that is under way, or null.
+	HTCNC::Progress*	m_progress;
+	/// True if the halftoning under way is generating g code.
+	bool							m_generatingGCode;
+	/// True if the settings changed while halftoning was under way.
+	bool							m_recomputePending;
 
 }; 
 
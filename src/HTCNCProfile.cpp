@@ -0,0 +1,330 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "HTCNCProfile.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDesktopServices>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QObject>
+#include <QSettings>
+
+#include <math.h>
+
+namespace HTCNC
+{
+	namespace
+	{
+		// Helpers that only touch a value if the key is present.
+		void readInt( QSettings& settings, const QString& key, int& value )
+		{
+			if ( settings.contains( key ) )
+				value = settings.value( key ).toInt();
+		}
+
+		void readDouble( QSettings& settings, const QString& key, double& value )
+		{
+			if ( settings.contains( key ) )
+				value = settings.value( key ).toDouble();
+		}
+
+		void readBool( QSettings& settings, const QString& key, bool& value )
+		{
+			if ( settings.contains( key ) )
+				value = settings.value( key ).toBool();
+		}
+
+		QString number( double value )
+		{
+			return QString::number( value, 'g', 17 );
+		}
+	}
+
+
+	void Profile::read( QSettings& settings )
+	{
+		readInt( settings, "halftone/source_pixel_step", m_params.m_step );
+		readDouble( settings, "halftone/min_dot_gap", m_params.m_minDotGap );
+		if ( settings.contains( "halftone/max_cut_depth_pct" ) )
+			m_params.m_maxCutPercent = settings.value( "halftone/max_cut_depth_pct" ).toInt() / 100.0;
+		readInt( settings, "halftone/depth_levels", m_params.m_depthLevels );
+		readDouble( settings, "halftone/gamma", m_params.m_gamma );
+		if ( settings.contains( "halftone/modulation" ) )
+			m_params.m_modulation = static_cast<Halftoner::Modulation>( settings.value( "halftone/modulation" ).toInt() );
+		if ( settings.contains( "halftone/lattice" ) )
+			m_params.m_lattice = static_cast<Halftoner::LatticeType>( settings.value( "halftone/lattice" ).toInt() );
+		readDouble( settings, "halftone/screen_angle", m_params.m_screenAngle );
+		readDouble( settings, "halftone/output_width", m_params.m_outputWidth );
+		readDouble( settings, "halftone/output_height", m_params.m_outputHeight );
+		readDouble( settings, "halftone/dot_pitch", m_params.m_dotPitch );
+
+		if ( settings.contains( "g_code/preamble" ) )
+			m_preamble = settings.value( "g_code/preamble" ).toString();
+		readBool( settings, "g_code/minimize_travel", m_params.m_minimizeTravel );
+
+		readDouble( settings, "tool/feed", m_feed );
+		readDouble( settings, "tool/speed", m_speed );
+		readDouble( settings, "tool/fast_z", m_params.m_fastZ );
+		readBool( settings, "tool/coolant", m_coolant );
+		readDouble( settings, "tool/full_tool_depth", m_params.m_fullToolDepth );
+		readDouble( settings, "tool/full_tool_width", m_params.m_fullToolWidth );
+		readDouble( settings, "tool/peck_depth", m_params.m_peckDepth );
+
+		readDouble( settings, "machine/min_x", m_params.m_travelLimits.m_minX );
+		readDouble( settings, "machine/max_x", m_params.m_travelLimits.m_maxX );
+		readDouble( settings, "machine/min_y", m_params.m_travelLimits.m_minY );
+		readDouble( settings, "machine/max_y", m_params.m_travelLimits.m_maxY );
+		readDouble( settings, "machine/min_z", m_params.m_travelLimits.m_minZ );
+		readDouble( settings, "machine/max_z", m_params.m_travelLimits.m_maxZ );
+
+		if ( settings.contains( "tool/additional_tools/size" ) )
+		{
+			int	tool_count( settings.beginReadArray( "tool/additional_tools" ) );
+
+			m_params.m_tools.clear();
+			for ( int i = 0; i < tool_count; ++i )
+			{
+				Halftoner::Tool	tool;
+
+				settings.setArrayIndex( i );
+				tool.m_number = settings.value( "number" ).toInt();
+				tool.m_fullToolDepth = settings.value( "full_tool_depth" ).toDouble();
+				tool.m_fullToolWidth = settings.value( "full_tool_width" ).toDouble();
+				tool.m_peckDepth = settings.value( "peck_depth" ).toDouble();
+				m_params.m_tools.push_back( tool );
+			}
+			settings.endArray();
+		}
+	}
+
+
+	void Profile::write( QSettings& settings ) const
+	{
+		settings.setValue( "halftone/source_pixel_step", m_params.m_step );
+		settings.setValue( "halftone/min_dot_gap", m_params.m_minDotGap );
+		settings.setValue( "halftone/max_cut_depth_pct", int( floor( m_params.m_maxCutPercent * 100 + 0.5 ) ) );
+		settings.setValue( "halftone/depth_levels", m_params.m_depthLevels );
+		settings.setValue( "halftone/gamma", m_params.m_gamma );
+		settings.setValue( "halftone/modulation", int( m_params.m_modulation ) );
+		settings.setValue( "halftone/lattice", int( m_params.m_lattice ) );
+		settings.setValue( "halftone/screen_angle", m_params.m_screenAngle );
+		settings.setValue( "halftone/output_width", m_params.m_outputWidth );
+		settings.setValue( "halftone/output_height", m_params.m_outputHeight );
+		settings.setValue( "halftone/dot_pitch", m_params.m_dotPitch );
+
+		settings.setValue( "g_code/preamble", m_preamble );
+		settings.setValue( "g_code/minimize_travel", m_params.m_minimizeTravel );
+
+		settings.setValue( "tool/feed", m_feed );
+		settings.setValue( "tool/speed", m_speed );
+		settings.setValue( "tool/fast_z", m_params.m_fastZ );
+		settings.setValue( "tool/coolant", m_coolant );
+		settings.setValue( "tool/full_tool_depth", m_params.m_fullToolDepth );
+		settings.setValue( "tool/full_tool_width", m_params.m_fullToolWidth );
+		settings.setValue( "tool/peck_depth", m_params.m_peckDepth );
+
+		settings.setValue( "machine/min_x", m_params.m_travelLimits.m_minX );
+		settings.setValue( "machine/max_x", m_params.m_travelLimits.m_maxX );
+		settings.setValue( "machine/min_y", m_params.m_travelLimits.m_minY );
+		settings.setValue( "machine/max_y", m_params.m_travelLimits.m_maxY );
+		settings.setValue( "machine/min_z", m_params.m_travelLimits.m_minZ );
+		settings.setValue( "machine/max_z", m_params.m_travelLimits.m_maxZ );
+
+		settings.beginWriteArray( "tool/additional_tools" );
+		for ( size_t i = 0; i < m_params.m_tools.size(); ++i )
+		{
+			const Halftoner::Tool&	tool( m_params.m_tools[i] );
+
+			settings.setArrayIndex( static_cast<int>( i ) );
+			settings.setValue( "number", tool.m_number );
+			settings.setValue( "full_tool_depth", tool.m_fullToolDepth );
+			settings.setValue( "full_tool_width", tool.m_fullToolWidth );
+			settings.setValue( "peck_depth", tool.m_peckDepth );
+		}
+		settings.endArray();
+	}
+
+
+	QByteArray Profile::hash() const
+	{
+		// A canonical text form of every field, in a fixed order.
+		QString	text;
+
+		text += "step=" + QString::number( m_params.m_step ) + "\n";
+		text += "depth=" + number( m_params.m_fullToolDepth ) + "\n";
+		text += "width=" + number( m_params.m_fullToolWidth ) + "\n";
+		text += "pct=" + number( m_params.m_maxCutPercent ) + "\n";
+		text += "gap=" + number( m_params.m_minDotGap ) + "\n";
+		text += "fast_z=" + number( m_params.m_fastZ ) + "\n";
+		text += "tool=" + QString::number( m_params.m_toolNumber ) + "\n";
+		text += "peck=" + number( m_params.m_peckDepth ) + "\n";
+		text += "travel=" + QString::number( m_params.m_minimizeTravel ) + "\n";
+		for ( size_t i = 0; i < m_params.m_tools.size(); ++i )
+		{
+			const Halftoner::Tool&	tool( m_params.m_tools[i] );
+
+			text += "extra_tool=" + QString::number( tool.m_number ) + "," +
+				number( tool.m_fullToolDepth ) + "," +
+				number( tool.m_fullToolWidth ) + "," +
+				number( tool.m_peckDepth ) + "\n";
+		}
+		text += "levels=" + QString::number( m_params.m_depthLevels ) + "\n";
+		text += "gamma=" + number( m_params.m_gamma ) + "\n";
+		text += "modulation=" + QString::number( int( m_params.m_modulation ) ) + "\n";
+		text += "lattice=" + QString::number( int( m_params.m_lattice ) ) + "\n";
+		text += "angle=" + number( m_params.m_screenAngle ) + "\n";
+		text += "output_width=" + number( m_params.m_outputWidth ) + "\n";
+		text += "output_height=" + number( m_params.m_outputHeight ) + "\n";
+		text += "dot_pitch=" + number( m_params.m_dotPitch ) + "\n";
+		// The limits don't change the g code, but only jobs that fit them are
+		// cached, so a cached job must have been checked against the same
+		// limits.
+		text += "limits=" + number( m_params.m_travelLimits.m_minX ) + "," +
+			number( m_params.m_travelLimits.m_maxX ) + "," +
+			number( m_params.m_travelLimits.m_minY ) + "," +
+			number( m_params.m_travelLimits.m_maxY ) + "," +
+			number( m_params.m_travelLimits.m_minZ ) + "," +
+			number( m_params.m_travelLimits.m_maxZ ) + "\n";
+		text += "feed=" + number( m_feed ) + "\n";
+		text += "speed=" + number( m_speed ) + "\n";
+		text += "coolant=" + QString::number( m_coolant ) + "\n";
+		text += "preamble=" + m_preamble + "\n";
+
+		return QCryptographicHash::hash( text.toUtf8(), QCryptographicHash::Sha1 ).toHex();
+	}
+
+
+	QByteArray Profile::formatGCodeFile( const QByteArray& gCode ) const
+	{
+		// The preamble
+		QString	preamble( "(" + QObject::tr("Generated by the CNC Halftone Wizard.") + ")\n" );
+
+		preamble += "(";
+		preamble += QObject::tr("Generated at ");
+		preamble += QDateTime::currentDateTime().toString( QObject::tr("HH:mm:ss dd MMM yyyy") );
+		preamble += ")\n";
+		preamble += m_preamble;
+		preamble += "\n";
+		preamble += "F" + QString::number(m_feed);
+		preamble += "\n";
+		preamble += "S" + QString::number(m_speed);
+		preamble += "\n";
+
+		if ( m_coolant )
+			preamble += "M08\n";
+
+		QString	postamble;
+		if ( m_coolant )
+			postamble += "M09\n";
+		postamble += "M30\n";
+
+		return preamble.toAscii() + gCode + postamble.toAscii();
+	}
+
+
+	bool Profile::writeGCodeFile( const QString& filename, const QByteArray& gCode ) const
+	{
+		QFile	file( filename );
+
+		// TODO: Consider getting rid of Text flag.  It causes all line feeds
+		// to be replaced with carriage return + line feed under Windows, which
+		// is kind of an anachronism and makes the output file less portable
+		// (since some linux apps still get heartburn from the CR+LF combo).
+		if ( ! file.open( QIODevice::WriteOnly | QIODevice::Text ) )
+			return false;
+
+		file.write( formatGCodeFile( gCode ) );
+		file.close();
+
+		return file.error() == QFile::NoError;
+	}
+
+
+	ProfileStore::ProfileStore( const QString& directory )
+		: m_directory( directory.isEmpty() ? defaultDirectory() : directory )
+	{
+	}
+
+
+	QString ProfileStore::defaultDirectory()
+	{
+		return QDesktopServices::storageLocation( QDesktopServices::DataLocation ) + "/profiles";
+	}
+
+
+	QStringList ProfileStore::names() const
+	{
+		QStringList	names;
+		QFileInfoList	files( QDir( m_directory ).entryInfoList( QStringList( "*.ini" ), QDir::Files, QDir::Name ) );
+
+		for ( int i = 0; i < files.size(); ++i )
+			names << files[i].completeBaseName();
+		return names;
+	}
+
+
+	bool ProfileStore::isValidName( const QString& name )
+	{
+		return ! name.isEmpty() && ! name.contains( '/' ) && ! name.contains( '\\' ) &&
+					 ! name.contains( ':' ) && ! name.contains( ".." );
+	}
+
+
+	bool ProfileStore::load( const QString& name, Profile& profile ) const
+	{
+		if ( ! isValidName( name ) || ! QFile::exists( filename( name ) ) )
+			return false;
+
+		QSettings	settings( filename( name ), QSettings::IniFormat );
+
+		profile.read( settings );
+		return true;
+	}
+
+
+	bool ProfileStore::save( const QString& name, const Profile& profile ) const
+	{
+		if ( ! isValidName( name ) || ! QDir().mkpath( m_directory ) )
+			return false;
+
+		// Start from an empty file so stale keys don't linger.
+		QFile::remove( filename( name ) );
+
+		QSettings	settings( filename( name ), QSettings::IniFormat );
+
+		profile.write( settings );
+		settings.sync();
+		return settings.status() == QSettings::NoError;
+	}
+
+
+	bool ProfileStore::remove( const QString& name ) const
+	{
+		return isValidName( name ) && QFile::remove( filename( name ) );
+	}
+
+
+	QString ProfileStore::filename( const QString& name ) const
+	{
+		return m_directory + "/" + name + ".ini";
+	}
+}
+
@@ -0,0 +1,118 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#ifndef HTCNCPROFILE_H
+#define HTCNCPROFILE_H
+
+#include "HTCNCHalftoner.h"
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+// Forward decls
+class QSettings;
+
+namespace HTCNC
+{
+
+	/*@brief Everything needed to turn an image into a g code file for a
+	 * particular machine and material.
+	 **/
+	struct Profile
+	{
+		Profile()
+			: m_feed(5.0)
+			, m_speed(5000)
+			, m_coolant(false)
+			, m_preamble("T1M06\nG90")
+		{
+		}
+
+		/// Reads the profile from settings.  Values missing from settings are
+		/// left as they are.
+		void read( QSettings& settings );
+
+		/// Writes the profile to settings.
+		void write( QSettings& settings ) const;
+
+		/// Returns a hash (as hex) of everything that affects the generated
+		/// g code, and of the travel limits it was checked against.
+		QByteArray hash() const;
+
+		/// Returns the contents of a complete g code file: the preamble, feed,
+		/// speed and coolant commands, the given cutter movement g code and
+		/// the postamble.
+		QByteArray formatGCodeFile( const QByteArray& gCode ) const;
+
+		/// Writes formatGCodeFile( gCode ) to a file.  Returns false if the
+		/// file could not be written.
+		bool writeGCodeFile( const QString& filename, const QByteArray& gCode ) const;
+
+		Halftoner::CNCParameters	m_params;	/// Parameters passed to the Halftoner
+		double	m_feed;				/// Feed rate for cutting moves
+		double	m_speed;			/// Spindle speed
+		bool		m_coolant;		/// If true, coolant is turned on for the job
+		QString	m_preamble;		/// Text written at the start of the g code
+	};
+
+
+	/*@brief Named profiles, each stored as an INI file in a directory.
+	 **/
+	class ProfileStore
+	{
+		public:
+			/// Uses the given directory, or the default one if it is empty.
+			ProfileStore( const QString& directory = QString() );
+
+			/// Returns the default location of the profile files.
+			static QString defaultDirectory();
+
+			/// Returns the names of the stored profiles.
+			QStringList names() const;
+
+			/// Returns false if a name can't be a profile's: it is empty, or it
+			/// contains a path separator, a drive colon or "..", any of which
+			/// could reach files outside the profile directory.
+			static bool isValidName( const QString& name );
+
+			/// Loads a profile.  Returns false if there is no such profile (or
+			/// the name isn't valid).
+			bool load( const QString& name, Profile& profile ) const;
+
+			/// Saves a profile, replacing any existing one with the same name.
+			/// Returns false if the profile could not be written (or the name
+			/// isn't valid).
+			bool save( const QString& name, const Profile& profile ) const;
+
+			/// Deletes a profile.  Returns false if it couldn't be deleted (or
+			/// the name isn't valid).
+			bool remove( const QString& name ) const;
+
+		private:
+			QString filename( const QString& name ) const;
+
+			QString	m_directory;
+	};
+
+}	// namespace HTCNC
+
+
+#endif
+
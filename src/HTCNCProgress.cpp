@@ -0,0 +1,98 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "HTCNCProgress.h"
+
+#include <stdio.h>
+
+namespace HTCNC
+{
+	Progress::Progress()
+		: m_cancelled(0)
+		, m_percent(-1)
+	{
+	}
+
+
+	Progress::~Progress()
+	{
+	}
+
+
+	void Progress::cancel()
+	{
+		m_cancelled.fetchAndStoreOrdered( 1 );
+	}
+
+
+	bool Progress::isCancelled()
+	{
+		return m_cancelled.fetchAndAddOrdered( 0 ) != 0;
+	}
+
+
+	bool Progress::update( int done, int total )
+	{
+		int	percent( total > 0 ? int( 100.0 * done / total ) : 100 );
+
+		if ( percent != m_percent )
+		{
+			m_percent = percent;
+			report( percent );
+		}
+		return ! isCancelled();
+	}
+
+
+	void Progress::report( int )
+	{
+	}
+
+
+	ProgressStage::ProgressStage( Progress* progress, int first, int last, int total )
+		: m_progress( progress )
+		, m_first( first )
+		, m_last( last )
+		, m_total( total )
+	{
+	}
+
+
+	bool ProgressStage::update( int done, int total ) const
+	{
+		if ( ! m_progress )
+			return true;
+		return m_progress->update( m_first + ( total > 0 ? int( double( m_last - m_first ) * done / total ) : 0 ), m_total );
+	}
+
+
+	StderrProgress::StderrProgress( const QString& label )
+		: m_label( label.toLocal8Bit() )
+	{
+	}
+
+
+	void StderrProgress::report( int percent )
+	{
+		// Keep rewriting the same line until the operation is done.
+		fprintf( stderr, "\r%s: %3d%%", m_label.constData(), percent );
+		if ( percent >= 100 )
+			fprintf( stderr, "\n" );
+		fflush( stderr );
+	}
+}
@@ -0,0 +1,114 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#ifndef HTCNCPROGRESS_H
+#define HTCNCPROGRESS_H
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QString>
+
+namespace HTCNC
+{
+
+	/*@brief Lets a long operation report its progress and be cancelled.
+	 *
+	 * The operation calls update() as it goes; update() is cheap, and only
+	 * calls report() when the percentage complete actually changes.
+	 * cancel() may be called from any thread (or from report() itself); the
+	 * operation stops the next time it calls update().
+	 **/
+	class Progress
+	{
+		public:
+			Progress();
+			virtual ~Progress();
+
+			/// Asks the operation to stop as soon as it can.
+			void cancel();
+
+			/// Returns true once cancel() has been called.
+			bool isCancelled();
+
+			/**
+			 * @brief Called by the operation to say how far along it is.
+			 * @param done The amount of work done so far.
+			 * @param total The total amount of work.
+			 * @return false if the operation should stop.
+			 **/
+			bool update( int done, int total );
+
+		protected:
+			/// Called with the percentage complete (0..100) whenever it
+			/// changes.  Does nothing by default.
+			virtual void report( int percent );
+
+		private:
+			QAtomicInt	m_cancelled;
+			int					m_percent;
+	};
+
+
+	/*@brief One stage of a longer operation.
+	 *
+	 * Lets a stage report its progress in terms of its own work while the
+	 * Progress sees it as the part of the whole operation that the stage
+	 * covers.  A stage without a Progress is never cancelled.
+	 **/
+	class ProgressStage
+	{
+		public:
+			/**
+			 * @brief Constructs a stage.
+			 * @param progress The operation's progress; may be null.
+			 * @param first, last The part of the operation the stage covers,
+			 * out of total.
+			 **/
+			ProgressStage( Progress* progress = 0, int first = 0, int last = 0, int total = 0 );
+
+			/// As Progress::update(), for the stage's own work.
+			bool update( int done, int total ) const;
+
+		private:
+			Progress*	m_progress;
+			int				m_first;
+			int				m_last;
+			int				m_total;
+	};
+
+
+	/*@brief Reports progress on stderr, for when there is no GUI.
+	 **/
+	class StderrProgress : public Progress
+	{
+		public:
+			/// label is printed in front of the percentage.
+			StderrProgress( const QString& label );
+
+		protected:
+			virtual void report( int percent );
+
+		private:
+			QByteArray	m_label;
+	};
+
+}	// namespace HTCNC
+
+
+#endif
@@ -0,0 +1,99 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "HTCNCSourceCache.h"
+#include "HTCNCImageLoader.h"
+
+#include <QMutexLocker>
+
+namespace HTCNC
+{
+	SourceCache::SourceCache( qint64 maxBytes )
+		: m_maxBytes( maxBytes )
+		, m_bytes(0)
+	{
+	}
+
+
+	QImage SourceCache::loadForJob( const QString& filename, const QByteArray& sourceHash, Halftoner::CNCParameters& params, int* reduction )
+	{
+		// Reading the header to work out the reduction is cheap.
+		ImageLoader	loader( filename );
+		int	r( loader.getReduction( params ) );
+
+		if ( reduction )
+			*reduction = r;
+
+		{
+			QMutexLocker	lock( &m_mutex );
+
+			for ( std::list<Entry>::iterator it = m_entries.begin(); it != m_entries.end(); ++it )
+			{
+				if ( it->m_sourceHash == sourceHash && it->m_reduction == r )
+				{
+					// Move it to the front.
+					m_entries.splice( m_entries.begin(), m_entries, it );
+					ImageLoader::adjustParams( params, r );
+					return m_entries.front().m_image;
+				}
+			}
+		}
+
+		// Decode without holding the lock, so other threads aren't held up.
+		// (Two threads that miss on the same image at once both decode it.)
+		QImage	image( loader.loadGrey( r ) );
+
+		if ( image.isNull() )
+			return image;
+
+		ImageLoader::adjustParams( params, r );
+
+		Entry	entry;
+
+		entry.m_sourceHash = sourceHash;
+		entry.m_reduction = r;
+		entry.m_image = image;
+
+		QMutexLocker	lock( &m_mutex );
+
+		m_entries.push_front( entry );
+		m_bytes += image.numBytes();
+		trim();
+		return image;
+	}
+
+
+	void SourceCache::clear()
+	{
+		QMutexLocker	lock( &m_mutex );
+
+		m_entries.clear();
+		m_bytes = 0;
+	}
+
+
+	void SourceCache::trim()
+	{
+		// The newest image is kept even if it is too big on its own.
+		while ( m_bytes > m_maxBytes && m_entries.size() > 1 )
+		{
+			m_bytes -= m_entries.back().m_image.numBytes();
+			m_entries.pop_back();
+		}
+	}
+}
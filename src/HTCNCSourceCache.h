@@ -0,0 +1,82 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+
+#ifndef HTCNCSOURCECACHE_H
+#define HTCNCSOURCECACHE_H
+
+#include "HTCNCHalftoner.h"
+
+#include <QByteArray>
+#include <QImage>
+#include <QMutex>
+#include <QString>
+
+#include <list>
+
+namespace HTCNC
+{
+
+	/*@brief Keeps recently decoded source images in memory.
+	 *
+	 * Decoding a big photo can take longer than halftoning it, and a job
+	 * server tends to see the same images over and over (with different
+	 * settings, or from different operators).  Images are kept by the hash
+	 * of the file's contents and the reduction they were loaded at, and the
+	 * least recently used ones are dropped once the cache holds more than
+	 * its limit.  The cache can be shared by any number of threads.
+	 **/
+	class SourceCache
+	{
+		public:
+			/// Creates a cache that holds up to maxBytes of images.
+			SourceCache( qint64 maxBytes = 256 * 1024 * 1024 );
+
+			/**
+			 * @brief Same as ImageLoader( filename ).loadForJob( params,
+			 * reduction ), but only decodes the image if it isn't in the cache.
+			 * @param sourceHash The hash of the file's contents (see
+			 * JobCache::hashFile()).
+			 **/
+			QImage loadForJob( const QString& filename, const QByteArray& sourceHash, Halftoner::CNCParameters& params, int* reduction = 0 );
+
+			/// Drops every image.
+			void clear();
+
+		private:
+			struct Entry
+			{
+				QByteArray	m_sourceHash;
+				int					m_reduction;
+				QImage			m_image;
+			};
+
+			/// Drops the least recently used images until the cache fits.
+			/// The mutex must be held.
+			void trim();
+
+			QMutex	m_mutex;
+			std::list<Entry>	m_entries;	/// Most recently used first
+			qint64	m_maxBytes;
+			qint64	m_bytes;
+	};
+
+}	// namespace HTCNC
+
+
+#endif
@@ -0,0 +1,24 @@
+CONFIG += qt qtestlib console
+CONFIG -= app_bundle
+MOC_DIR = ./moc_bench
+OBJECTS_DIR = ./obj_bench
+TARGET = HalftonerBenchmark
+
+INCLUDEPATH += ../src
+
+TEMPLATE = app
+
+SOURCES += \
+			HTCNCBenchmark.cpp \
+			../src/HTCNCBlockPyramid.cpp \
+			../src/HTCNCDepthMap.cpp \
+			../src/HTCNCDotField.cpp \
+			../src/HTCNCDotModulator.cpp \
+			../src/HTCNCGreyPlane.cpp \
+			../src/HTCNCHalftoner.cpp \
+			../src/HTCNCImageLoader.cpp \
+			../src/HTCNCIntegralImage.cpp \
+			../src/HTCNCJobPlanner.cpp \
+			../src/HTCNCKernels.cpp \
+			../src/HTCNCLattice.cpp \
+			../src/HTCNCProgress.cpp
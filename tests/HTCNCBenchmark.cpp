@@ -0,0 +1,160 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "HTCNCGreyPlane.h"
+#include "HTCNCHalftoner.h"
+#include "HTCNCImageLoader.h"
+#include "HTCNCKernels.h"
+#include "HTCNCLattice.h"
+
+#include <QImage>
+#include <QtTest>
+
+using namespace HTCNC;
+
+namespace
+{
+	// The size of the benchmark image: a 12 megapixel photo.
+	const int	IMAGE_WIDTH( 4000 );
+	const int	IMAGE_HEIGHT( 3000 );
+}
+
+
+/*@brief Benchmarks for the halftoning kernels.
+ *
+ * Everything runs on one large generated 8 bit grey image at the typical
+ * pixel steps.  blockMean times averaging every cell of the lattice with
+ * the kernel getBlockMeanFunction() picks for the step, against the
+ * generic getMeanIntensity().  halftone times a whole preview run (without
+ * g code), as the main window does it.
+ **/
+class HalftonerBenchmark : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void initTestCase();
+	void blockMean_data();
+	void blockMean();
+	void halftone_data();
+	void halftone();
+
+private:
+	QImage	m_source;
+};
+
+
+void HalftonerBenchmark::initTestCase()
+{
+	m_source = QImage( IMAGE_WIDTH, IMAGE_HEIGHT, QImage::Format_Indexed8 );
+	m_source.setColorTable( ImageLoader::greyTable() );
+
+	unsigned int	seed( 12345 );
+
+	// A ramp with some noise on it, so there are no uniform blocks for the
+	// Halftoner to skip.
+	for ( int y = 0; y < IMAGE_HEIGHT; ++y )
+	{
+		uchar*	line( m_source.scanLine( y ) );
+
+		for ( int x = 0; x < IMAGE_WIDTH; ++x )
+		{
+			seed = seed * 1103515245 + 12345;
+			line[x] = uchar( ( x + y ) * 192 / ( IMAGE_WIDTH + IMAGE_HEIGHT ) + ( ( seed >> 16 ) & 0x3f ) );
+		}
+	}
+}
+
+
+void HalftonerBenchmark::blockMean_data()
+{
+	QTest::addColumn<int>( "step" );
+	QTest::addColumn<bool>( "generic" );
+
+	QTest::newRow( "step_4" ) << 4 << false;
+	QTest::newRow( "step_4_generic" ) << 4 << true;
+	QTest::newRow( "step_6" ) << 6 << false;
+	QTest::newRow( "step_6_generic" ) << 6 << true;
+	QTest::newRow( "step_8" ) << 8 << false;
+	QTest::newRow( "step_8_generic" ) << 8 << true;
+	QTest::newRow( "step_12" ) << 12 << false;
+	QTest::newRow( "step_12_generic" ) << 12 << true;
+}
+
+
+void HalftonerBenchmark::blockMean()
+{
+	QFETCH( int, step );
+	QFETCH( bool, generic );
+
+	Halftoner::CNCParameters	params;
+
+	params.m_step = step;
+
+	Lattice		lattice( params, m_source.width(), m_source.height() );
+	const std::vector<Lattice::Cell>&	cells( lattice.getCells() );
+	GreyPlane	plane( m_source );
+	BlockMeanFunction	block_mean( generic ? getMeanIntensity : getBlockMeanFunction( step ) );
+	int	expected( 0 ), total( 0 );
+
+	for ( size_t k = 0; k < cells.size(); ++k )
+		expected += getMeanIntensity( plane, cells[k] );
+
+	QBENCHMARK
+	{
+		total = 0;
+		for ( size_t k = 0; k < cells.size(); ++k )
+			total += block_mean( plane, cells[k] );
+	}
+
+	QCOMPARE( total, expected );
+}
+
+
+void HalftonerBenchmark::halftone_data()
+{
+	QTest::addColumn<int>( "step" );
+
+	QTest::newRow( "step_4" ) << 4;
+	QTest::newRow( "step_6" ) << 6;
+	QTest::newRow( "step_8" ) << 8;
+	QTest::newRow( "step_12" ) << 12;
+}
+
+
+void HalftonerBenchmark::halftone()
+{
+	QFETCH( int, step );
+
+	Halftoner::CNCParameters	params;
+
+	params.m_step = step;
+
+	QImage	preview( m_source.width(), m_source.height(), QImage::Format_Indexed8 );
+
+	preview.setColorTable( ImageLoader::greyTable() );
+
+	QBENCHMARK
+	{
+		Halftoner	ht( m_source, preview, 1, false, params );
+	}
+}
+
+
+QTEST_MAIN(HalftonerBenchmark)
+#include "HTCNCBenchmark.moc"
@@ -0,0 +1,537 @@
+/******************************************************************************
+* CNC Halftone Wizard
+* Copyright (C) 2011 Paul Kerchen
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "HTCNCHalftoner.h"
+#include "HTCNCImageLoader.h"
+
+#include <QDir>
+#include <QFile>
+#include <QImage>
+#include <QTemporaryFile>
+#include <QTextStream>
+#include <QtTest>
+
+#include <algorithm>
+#include <vector>
+
+#include <math.h>
+#include <stdlib.h>
+
+using namespace HTCNC;
+
+namespace
+{
+	// G code numbers may differ by this much (in program units).
+	const double	GCODE_TOLERANCE( 1e-4 );
+	// Preview pixels may differ by this many grey levels...
+	const int			PIXEL_TOLERANCE( 2 );
+	// ...and this fraction of them may differ by more.
+	const double	MAX_DIFFERING_PIXELS( 0.001 );
+	// A reduced decode may move a dot this many depth levels when the
+	// loader averages the image down...
+	const int			REDUCED_LEVEL_TOLERANCE( 1 );
+	// ...and this many when the JPEG decoder scales it.
+	const int			REDUCED_JPEG_LEVEL_TOLERANCE( 3 );
+
+
+	// One fixed image run with one set of parameters.
+	struct Case
+	{
+		const char*	m_name;
+		const char*	m_image;
+		Halftoner::CNCParameters	m_params;
+		int					m_scale;
+	};
+
+
+	std::vector<Case> makeCases()
+	{
+		std::vector<Case>	cases;
+		Case	c;
+
+		c.m_name = "ramp_defaults";
+		c.m_image = "ramp";
+		c.m_scale = 1;
+		cases.push_back( c );
+
+		c = Case();
+		c.m_name = "radial_square_levels";
+		c.m_image = "radial";
+		c.m_params.m_lattice = Halftoner::SQUARE;
+		c.m_params.m_step = 4;
+		c.m_params.m_depthLevels = 8;
+		c.m_params.m_modulation = Halftoner::FLOYD_STEINBERG;
+		c.m_scale = 2;
+		cases.push_back( c );
+
+		c = Case();
+		c.m_name = "checker_hexagonal_tools";
+		c.m_image = "checker";
+		c.m_params.m_lattice = Halftoner::HEXAGONAL;
+		c.m_params.m_peckDepth = 0.05;
+		c.m_params.m_minimizeTravel = true;
+		{
+			Halftoner::Tool	tool;
+
+			tool.m_number = 2;
+			tool.m_fullToolDepth = 0.25;
+			tool.m_fullToolWidth = 0.15;
+			c.m_params.m_tools.push_back( tool );
+		}
+		c.m_scale = 1;
+		cases.push_back( c );
+
+		c = Case();
+		c.m_name = "noise_rotated_ordered";
+		c.m_image = "noise";
+		c.m_params.m_lattice = Halftoner::ROTATED;
+		c.m_params.m_screenAngle = 30;
+		c.m_params.m_step = 8;
+		c.m_params.m_gamma = 1.5;
+		c.m_params.m_modulation = Halftoner::ORDERED;
+		c.m_scale = 1;
+		cases.push_back( c );
+
+		c = Case();
+		c.m_name = "ramp_output_size";
+		c.m_image = "ramp";
+		c.m_params.m_outputWidth = 3;
+		c.m_params.m_dotPitch = 0.15;
+		c.m_params.m_modulation = Halftoner::JARVIS;
+		c.m_scale = 1;
+		cases.push_back( c );
+
+		return cases;
+	}
+
+
+	// Draws one of the fixed test images.
+	QImage makeImage( const QString& kind )
+	{
+		const int	width( 160 ), height( 120 );
+		QImage	image( width, height, QImage::Format_RGB32 );
+		unsigned int	seed( 12345 );
+
+		for ( int y = 0; y < height; ++y )
+		{
+			for ( int x = 0; x < width; ++x )
+			{
+				int	value( 0 );
+
+				if ( kind == "ramp" )
+					value = x * 255 / ( width - 1 );
+				else if ( kind == "radial" )
+					value = std::min( 255, int( 2.5 * sqrt( double( ( x - 80 ) * ( x - 80 ) + ( y - 60 ) * ( y - 60 ) ) ) ) );
+				else if ( kind == "checker" )
+					value = ( ( x / 20 + y / 20 ) % 2 ) ? 230 : 40;
+				else
+				{
+					// A fixed pseudo-random pattern (not rand(), which varies by
+					// platform).
+					seed = seed * 1103515245 + 12345;
+					value = ( seed >> 16 ) & 0xff;
+				}
+				image.setPixel( x, y, qRgb( value, 255 - value / 2, value / 3 ) );
+			}
+		}
+		return image;
+	}
+
+
+	// Splits a line of g code into words: a comment, a letter, or a number.
+	QStringList splitWords( const QString& line )
+	{
+		QStringList	words;
+		int	i( 0 );
+
+		while ( i < line.size() )
+		{
+			QChar	c( line[i] );
+
+			if ( c.isSpace() )
+				++i;
+			else if ( c == '(' )
+			{
+				int	end( line.indexOf( ')', i ) );
+
+				end = end < 0 ? line.size() : end + 1;
+				words << line.mid( i, end - i );
+				i = end;
+			}
+			else if ( c.isDigit() || c == '-' || c == '+' || c == '.' )
+			{
+				int	start( i );
+
+				for ( ++i; i < line.size() && ( line[i].isDigit() || line[i] == '.' ); ++i )
+					;
+				words << line.mid( start, i - start );
+			}
+			else
+			{
+				words << QString( c );
+				++i;
+			}
+		}
+		return words;
+	}
+
+
+	// Compares two g code programs, allowing numbers to differ slightly.
+	// Returns an empty string if they match, or what differs.
+	QString compareGCode( const QString& actual, const QString& expected )
+	{
+		QStringList	actual_lines( actual.split( '\n' ) );
+		QStringList	expected_lines( expected.split( '\n' ) );
+
+		if ( actual_lines.size() != expected_lines.size() )
+			return QString( "%1 lines instead of %2" ).arg( actual_lines.size() ).arg( expected_lines.size() );
+
+		for ( int i = 0; i < actual_lines.size(); ++i )
+		{
+			QStringList	a( splitWords( actual_lines[i] ) );
+			QStringList	e( splitWords( expected_lines[i] ) );
+			bool	same( a.size() == e.size() );
+
+			for ( int w = 0; same && w < a.size(); ++w )
+			{
+				bool	a_number, e_number;
+				double	a_value( a[w].toDouble( &a_number ) );
+				double	e_value( e[w].toDouble( &e_number ) );
+
+				if ( a_number && e_number )
+					same = fabs( a_value - e_value ) <= GCODE_TOLERANCE;
+				else
+					same = a[w] == e[w];
+			}
+			if ( ! same )
+				return QString( "line %1 is '%2' instead of '%3'" ).arg( i + 1 ).arg( actual_lines[i] ).arg( expected_lines[i] );
+		}
+		return QString();
+	}
+
+
+	// Returns the number of pixels whose intensities differ by more than
+	// PIXEL_TOLERANCE, or -1 if the images are different sizes.
+	int countDifferingPixels( const QImage& a, const QImage& b )
+	{
+		if ( a.size() != b.size() )
+			return -1;
+
+		int	count( 0 );
+
+		for ( int y = 0; y < a.height(); ++y )
+		{
+			for ( int x = 0; x < a.width(); ++x )
+			{
+				if ( abs( qGray( a.pixel( x, y ) ) - qGray( b.pixel( x, y ) ) ) > PIXEL_TOLERANCE )
+					++count;
+			}
+		}
+		return count;
+	}
+
+
+	// Returns an empty 8 bit grey preview image, as the main window uses.
+	QImage makePreview( int width, int height )
+	{
+		QImage	preview( width, height, QImage::Format_Indexed8 );
+
+		preview.setColorTable( ImageLoader::greyTable() );
+		return preview;
+	}
+}
+
+
+/*@brief Regression tests for the Halftoner.
+ *
+ * Each case halftones a fixed, generated image with fixed parameters and
+ * compares the g code, cut count and preview with golden files in
+ * tests/golden; a case whose golden files are missing fails.  If the
+ * HTCNC_RECORD_GOLDEN environment variable is set, the current output is
+ * recorded as the golden files instead and the case is skipped.
+ **/
+class HalftonerTest : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void halftone_data();
+	void halftone();
+	void reducedDecode_data();
+	void reducedDecode();
+	void travelLimits();
+	void toolChanges();
+
+private:
+	std::vector<Case>	m_cases;
+};
+
+
+void HalftonerTest::halftone_data()
+{
+	QTest::addColumn<int>( "index" );
+
+	m_cases = makeCases();
+	for ( size_t i = 0; i < m_cases.size(); ++i )
+		QTest::newRow( m_cases[i].m_name ) << int( i );
+}
+
+
+void HalftonerTest::halftone()
+{
+	QFETCH( int, index );
+
+	const Case&	c( m_cases[index] );
+	QImage	source( makeImage( c.m_image ) );
+	QImage	preview( makePreview( source.width() * c.m_scale, source.height() * c.m_scale ) );
+	Halftoner	ht( source, preview, c.m_scale, true, c.m_params );
+
+	QDir		golden( HTCNC_GOLDEN_DIR );
+	QString	gcode_filename( golden.filePath( QString( c.m_name ) + ".ngc" ) );
+	QString	preview_filename( golden.filePath( QString( c.m_name ) + ".png" ) );
+	// The cut count is kept in a comment at the top of the golden g code.
+	QString	gcode( QString( "(cuts %1)\n" ).arg( ht.getCutCount() ) + ht.getGCode() );
+
+	if ( ! qgetenv( "HTCNC_RECORD_GOLDEN" ).isEmpty() )
+	{
+		QFile	file( gcode_filename );
+
+		golden.mkpath( "." );
+		QVERIFY( file.open( QIODevice::WriteOnly | QIODevice::Text ) );
+		file.write( gcode.toAscii() );
+		QVERIFY( preview.save( preview_filename, "PNG" ) );
+		QSKIP( "Recorded the golden files.", SkipSingle );
+	}
+
+	// A missing golden file is a failure, not something to quietly replace.
+	if ( ! QFile::exists( gcode_filename ) || ! QFile::exists( preview_filename ) )
+		QFAIL( qPrintable( QString( "The golden files for %1 are missing." ).arg( c.m_name ) ) );
+
+	QFile	file( gcode_filename );
+
+	QVERIFY( file.open( QIODevice::ReadOnly | QIODevice::Text ) );
+
+	QString	expected( QTextStream( &file ).readAll() );
+	QString	expected_cuts( expected.section( '\n', 0, 0 ) );
+	QString	actual_cuts( gcode.section( '\n', 0, 0 ) );
+
+	QCOMPARE( actual_cuts, expected_cuts );
+
+	QString	difference( compareGCode( gcode, expected ) );
+
+	QVERIFY2( difference.isEmpty(), qPrintable( difference ) );
+
+	QImage	expected_preview( preview_filename );
+	int			differing( countDifferingPixels( preview, expected_preview ) );
+
+	QVERIFY2( differing >= 0, "The preview is the wrong size." );
+	QVERIFY2( differing <= MAX_DIFFERING_PIXELS * preview.width() * preview.height(),
+						qPrintable( QString( "%1 preview pixels differ." ).arg( differing ) ) );
+}
+
+
+void HalftonerTest::reducedDecode_data()
+{
+	QTest::addColumn<int>( "lattice" );
+	QTest::addColumn<int>( "step" );
+	QTest::addColumn<int>( "width" );
+	QTest::addColumn<int>( "height" );
+	QTest::addColumn<QString>( "format" );
+	QTest::addColumn<int>( "expectedReduction" );
+
+	QTest::newRow( "offset_4" ) << int( Halftoner::OFFSET_ROWS ) << 4 << 128 << 96 << QString( "PNG" ) << 2;
+	QTest::newRow( "square_8" ) << int( Halftoner::SQUARE ) << 8 << 128 << 96 << QString( "PNG" ) << 4;
+	QTest::newRow( "offset_16" ) << int( Halftoner::OFFSET_ROWS ) << 16 << 128 << 96 << QString( "PNG" ) << 8;
+	// The height isn't a multiple of the step, so the bottom-up rows of the
+	// offset lattice don't start at the edge of a block.
+	QTest::newRow( "offset_8_short" ) << int( Halftoner::OFFSET_ROWS ) << 8 << 128 << 100 << QString( "PNG" ) << 4;
+	// An odd height can't be reduced at all.
+	QTest::newRow( "offset_8_odd" ) << int( Halftoner::OFFSET_ROWS ) << 8 << 128 << 103 << QString( "PNG" ) << 1;
+	// JPEGs are scaled by the decoder instead.
+	QTest::newRow( "offset_4_jpeg" ) << int( Halftoner::OFFSET_ROWS ) << 4 << 128 << 96 << QString( "JPEG" ) << 2;
+	QTest::newRow( "square_8_jpeg" ) << int( Halftoner::SQUARE ) << 8 << 128 << 96 << QString( "JPEG" ) << 4;
+	QTest::newRow( "offset_16_jpeg" ) << int( Halftoner::OFFSET_ROWS ) << 16 << 128 << 96 << QString( "JPEG" ) << 8;
+}
+
+
+// Loading a source at reduced size must give the same job as loading it at
+// full size, except that the dots may be a depth level or so off.  The
+// image varies from pixel to pixel, so the rounding of the reduced pixels
+// shows up.
+void HalftonerTest::reducedDecode()
+{
+	QFETCH( int, lattice );
+	QFETCH( int, step );
+	QFETCH( int, width );
+	QFETCH( int, height );
+	QFETCH( QString, format );
+	QFETCH( int, expectedReduction );
+
+	QImage	source( width, height, QImage::Format_RGB32 );
+	unsigned int	seed( 12345 );
+
+	for ( int y = 0; y < source.height(); ++y )
+	{
+		for ( int x = 0; x < source.width(); ++x )
+		{
+			// A diagonal ramp with some noise on it, kept away from white so
+			// every cell gets a dot.
+			seed = seed * 1103515245 + 12345;
+
+			int	value( 40 + ( x * 3 + y * 2 ) % 100 + ( ( seed >> 16 ) & 0xff ) * 40 / 255 );
+
+			source.setPixel( x, y, qRgb( value, value, value ) );
+		}
+	}
+
+	QTemporaryFile	file( QDir::tempPath() + "/htcnctestXXXXXX." + format.toLower() );
+
+	QVERIFY( file.open() );
+	QVERIFY( source.save( &file, qPrintable( format ) ) );
+	file.close();
+
+	Halftoner::CNCParameters	params;
+
+	params.m_lattice = static_cast<Halftoner::LatticeType>( lattice );
+	params.m_step = step;
+
+	Halftoner::CNCParameters	reduced_params( params );
+	int			reduction;
+	QImage	full( file.fileName() );
+	QImage	reduced( ImageLoader( file.fileName() ).loadForJob( reduced_params, &reduction ) );
+
+	QVERIFY( ! full.isNull() );
+	QVERIFY( ! reduced.isNull() );
+	QCOMPARE( reduction, expectedReduction );
+
+	QImage		no_preview;
+	Halftoner	full_ht( full, no_preview, 1, true, params );
+	Halftoner	reduced_ht( reduced, no_preview, reduction, true, reduced_params );
+	const std::vector<Halftoner::Dot>&	full_dots( full_ht.getDots() );
+	const std::vector<Halftoner::Dot>&	reduced_dots( reduced_ht.getDots() );
+
+	QCOMPARE( reduced_dots.size(), full_dots.size() );
+
+	int	max_difference( 0 );
+
+	for ( size_t i = 0; i < full_dots.size(); ++i )
+	{
+		QVERIFY( fabs( reduced_dots[i].m_x - full_dots[i].m_x ) <= GCODE_TOLERANCE );
+		QVERIFY( fabs( reduced_dots[i].m_y - full_dots[i].m_y ) <= GCODE_TOLERANCE );
+		max_difference = std::max( max_difference, abs( reduced_dots[i].m_level - full_dots[i].m_level ) );
+	}
+
+	int	tolerance( format == "JPEG" ? REDUCED_JPEG_LEVEL_TOLERANCE : REDUCED_LEVEL_TOLERANCE );
+
+	QVERIFY2( max_difference <= tolerance,
+						qPrintable( QString( "A dot is %1 levels off." ).arg( max_difference ) ) );
+	if ( reduction == 1 )
+		QCOMPARE( reduced_ht.getGCode(), full_ht.getGCode() );
+}
+
+
+// The extents tallied while the g code is generated must be the ones the
+// g code actually reaches, and jobs outside the travel limits must be
+// flagged.
+void HalftonerTest::travelLimits()
+{
+	QImage	source( makeImage( "ramp" ) );
+	QImage	no_preview;
+	Halftoner::CNCParameters	params;
+
+	params.m_peckDepth = 0.05;
+
+	Halftoner	ht( source, no_preview, 1, true, params );
+	const Halftoner::MoveStatistics&	stats( ht.getMoveStatistics() );
+
+	QVERIFY( ht.getTravelErrors().isEmpty() );
+	QCOMPARE( stats.m_maxZ, params.m_fastZ );
+	QVERIFY( stats.m_minZ < -params.m_peckDepth );
+	QVERIFY( stats.m_minX < stats.m_maxX );
+	QVERIFY( stats.m_minY < stats.m_maxY );
+	QVERIFY( stats.m_feedCount > ht.getCutCount() );
+
+	// Every X and Y in the g code lies within the extents, and the
+	// extremes are reached.
+	QStringList	words( splitWords( ht.getGCode() ) );
+	double	min_x( 1e9 ), max_x( -1e9 ), min_y( 1e9 ), max_y( -1e9 );
+
+	for ( int i = 0; i + 1 < words.size(); ++i )
+	{
+		if ( words[i] == "X" )
+		{
+			min_x = qMin( min_x, words[i+1].toDouble() );
+			max_x = qMax( max_x, words[i+1].toDouble() );
+		}
+		else if ( words[i] == "Y" )
+		{
+			min_y = qMin( min_y, words[i+1].toDouble() );
+			max_y = qMax( max_y, words[i+1].toDouble() );
+		}
+	}
+	QVERIFY( fabs( min_x - stats.m_minX ) <= GCODE_TOLERANCE );
+	QVERIFY( fabs( max_x - stats.m_maxX ) <= GCODE_TOLERANCE );
+	QVERIFY( fabs( min_y - stats.m_minY ) <= GCODE_TOLERANCE );
+	QVERIFY( fabs( max_y - stats.m_maxY ) <= GCODE_TOLERANCE );
+
+	// A machine that can't reach the far edge, or go as deep as the
+	// deepest cut.
+	params.m_travelLimits.m_minX = 0;
+	params.m_travelLimits.m_maxX = stats.m_maxX / 2;
+	params.m_travelLimits.m_minZ = stats.m_minZ / 2;
+	params.m_travelLimits.m_maxZ = 1;
+
+	Halftoner	limited( source, no_preview, 1, true, params );
+
+	QCOMPARE( limited.getTravelErrors().size(), 2 );
+	QCOMPARE( limited.getGCode(), ht.getGCode() );
+}
+
+
+// A job that uses an additional tool must change back to the primary tool
+// at the end, and one that doesn't must not change tools at all.
+void HalftonerTest::toolChanges()
+{
+	QImage	source( makeImage( "checker" ) );
+	QImage	no_preview;
+	Halftoner::CNCParameters	params;
+
+	params.m_toolNumber = 3;
+
+	Halftoner	single( source, no_preview, 1, true, params );
+
+	QVERIFY( ! single.getGCode().contains( "M06" ) );
+
+	Halftoner::Tool	tool;
+
+	tool.m_number = 2;
+	tool.m_fullToolDepth = 0.25;
+	tool.m_fullToolWidth = 0.15;
+	params.m_tools.push_back( tool );
+
+	Halftoner	ht( source, no_preview, 1, true, params );
+	QString		gcode( ht.getGCode() );
+
+	QCOMPARE( gcode.count( "M06" ), 2 );
+	QVERIFY( gcode.contains( "T2M06\nG43H2\nM03\n" ) );
+	QVERIFY( gcode.endsWith( "T3M06\nG43H3\n" ) );
+}
+
+
+QTEST_MAIN(HalftonerTest)
+#include "HTCNCHalftonerTest.moc"
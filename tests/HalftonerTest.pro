@@ -0,0 +1,28 @@
+CONFIG += qt qtestlib console
+CONFIG -= app_bundle
+MOC_DIR = ./moc
+OBJECTS_DIR = ./obj
+TARGET = HalftonerTest
+
+INCLUDEPATH += ../src
+
+# Golden g code and previews; a missing one fails its test.  Set
+# HTCNC_RECORD_GOLDEN=1 to record new ones.
+DEFINES += HTCNC_GOLDEN_DIR=\\\"$$PWD/golden\\\"
+
+TEMPLATE = app
+
+SOURCES += \
+			HTCNCHalftonerTest.cpp \
+			../src/HTCNCBlockPyramid.cpp \
+			../src/HTCNCDepthMap.cpp \
+			../src/HTCNCDotField.cpp \
+			../src/HTCNCDotModulator.cpp \
+			../src/HTCNCGreyPlane.cpp \
+			../src/HTCNCHalftoner.cpp \
+			../src/HTCNCImageLoader.cpp \
+			../src/HTCNCIntegralImage.cpp \
+			../src/HTCNCJobPlanner.cpp \
+			../src/HTCNCKernels.cpp \
+			../src/HTCNCLattice.cpp \
+			../src/HTCNCProgress.cpp 